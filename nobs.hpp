@@ -1,15 +1,42 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
 #include <filesystem>
 #include <format>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <poll.h>
 #include <print>
 #include <ranges>
+#include <sched.h>
+#include <set>
+#include <signal.h>
 #include <source_location>
+#include <span>
+#include <spawn.h>
 #include <sstream>
 #include <string_view>
 #include <string>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <thread>
+#include <tuple>
 #include <unistd.h>
 #include <utility>
 #include <variant>
@@ -22,6 +49,7 @@ namespace nobs::internal
 {
     static std::string compiler = "g++";
     static std::string linker = "g++";
+    static std::string archiver = "ar";
 
     // TODO: make some parts of code be hidden by some internal namespace
     // to avoid polluting nobs namespace
@@ -33,29 +61,150 @@ namespace nobs::internal
     constexpr auto YELLOW_FONT = "\033[33;1m";
     constexpr auto BLUE_FONT  = "\033[34;1m";
 
-    constexpr auto metafile_extension = ".meta";
+    constexpr auto build_state_file = ".nobs_state";
+    constexpr std::string_view build_state_magic = "NOBSSTAT";
+    constexpr uint64_t build_state_version = 1;
     constexpr auto object_file_extension = ".o";
+    constexpr auto depfile_extension = ".d";
+    constexpr auto diagnostics_file_extension = ".diag";  // captured output of job, stored next to its output file
+    constexpr auto time_trace_extension = ".time.json";
+    constexpr auto time_report_extension = ".time";
+    constexpr auto include_tree_extension = ".includes";
+    constexpr auto response_file_extension = ".rsp";
+    constexpr auto driver_dry_run_flag = "-###";
+    constexpr auto frontend_flag = "-cc1";
+    constexpr auto direct_compile_source = "nobs_direct_compile_source";  // placeholders expanded by driver once per flag set
+    constexpr auto direct_compile_object = "/nobs_direct_compile_object.o";
+    constexpr size_t default_response_file_threshold = 32 * 1024;  // bytes of command line, well below ARG_MAX
+    constexpr auto cache_manifests_directory = "manifests";
+    constexpr auto cache_objects_directory = "objects";
+    constexpr auto precompiled_headers_directory = "pch";
+    constexpr auto gcc_precompiled_header_extension = ".gch";
+    constexpr auto clang_precompiled_header_extension = ".pch";
+    constexpr auto modules_directory = "modules";
+    constexpr auto module_dependencies_extension = ".ddi";
+    constexpr auto gcc_module_extension = ".gcm";
+    constexpr auto clang_module_extension = ".pcm";
+    constexpr auto gcc_module_mapper_file = "module.map";
+    constexpr auto clang_module_scanner = "clang-scan-deps";
+    constexpr auto unity_directory = "unity";
+    constexpr auto unity_state_file = "unity.state";
+    constexpr uint64_t default_unity_batch_milliseconds = 10000;
+    constexpr double default_milliseconds_per_line = 1.0;  // used until real compile times are recorded
+    constexpr uint64_t default_link_milliseconds = 100;  // used until real link time is recorded
+    constexpr auto cgroup_root_directory = "/sys/fs/cgroup";
+    constexpr auto jobserver_fifo = ".nobs_jobserver";
+    constexpr auto default_link_pool = "link";  // link jobs run without limit until pool with this name is added
+    constexpr char jobserver_token = '+';
+    constexpr int command_not_found_exit_code = 127;  // same as shell reports for command it can't execute
+    constexpr auto open_descriptors_directory = "/proc/self/fd";
+    constexpr auto cpu_pressure_file = "/proc/pressure/cpu";
+    constexpr auto memory_pressure_file = "/proc/pressure/memory";
+    constexpr auto cgroup_cpu_pressure_file = "cpu.pressure";
+    constexpr auto cgroup_memory_pressure_file = "memory.pressure";
+    constexpr auto load_average_file = "/proc/loadavg";
+    constexpr int adaptive_jobs_interval_milliseconds = 1000;
+    constexpr double cpu_pressure_limit = 40.0;  // percent of time some tasks waited for CPU in last 10 seconds
+    constexpr double memory_pressure_limit = 10.0;  // percent of time some tasks waited for memory in last 10 seconds
+    constexpr auto build_log_file = ".nobs_log";
+    constexpr auto build_log_header = "# nobs log v2";
+    constexpr size_t build_log_history_size = 10;  // entries kept per output when log is compacted
     constexpr auto default_build_directory = "./build_dir";
     constexpr auto default_cpp_standard = "--std=c++23";
     constexpr auto current_directory = ".";
     constexpr auto compile_flag = "-c";
+    constexpr auto language_flag = "-x";
+    constexpr auto precompiled_header_language = "c++-header";
+    constexpr auto include_flag = "-include";
+    constexpr auto include_tree_flag = "-H";
+    constexpr auto preprocess_flag = "-E";
+    constexpr auto cpp_language = "c++";
+    constexpr auto cpp_module_language = "c++-module";
     constexpr auto compile_output_flag = "-o";
+    constexpr auto depfile_generation_flag = "-MMD";
+    constexpr auto depfile_output_flag = "-MF";
     constexpr auto linker_output_flag = "-o";
+    constexpr auto thin_archive_flag = "--thin";
+    constexpr auto archive_members_extension = ".members";  // member list and format of archive as of its last update
+
+struct FileStamp
+{
+    uint64_t timestamp{};
+    uint64_t size{};
+    uint64_t inode{};
+    uint64_t content_hash{};  // 0 when content was not hashed
+};
+
+bool have_same_stat(const FileStamp& lhs, const FileStamp& rhs)
+{
+    return lhs.timestamp == rhs.timestamp and
+        lhs.size == rhs.size and
+        lhs.inode == rhs.inode;
+}
+
+struct HeaderDependency
+{
+    std::filesystem::path header_file;
+    FileStamp header_stamp;
+};
+
+// Flag set of compile jobs interned once per distinct text, together with its arguments already split for argv.
+// All translation units of target share one, so neither the text is copied per job nor split again per spawn.
+class CompileFlags
+{
+public:
+    CompileFlags() : CompileFlags(std::string_view{}) {}
+    explicit CompileFlags(const std::string_view& text)
+    {
+        auto& interned = interned_flags();
+        auto found = interned.find(text);
+        if (found == interned.end())
+        {
+            std::vector<std::string> arguments{};
+            std::istringstream iss{std::string{text}};
+            for (std::string argument{}; iss >> argument; )
+            {
+                arguments.push_back(argument);
+            }
+            found = interned.emplace(std::string{text}, std::move(arguments)).first;
+        }
+        entry_ = &*found;
+    }
+
+    const std::string& text() const { return entry_->first; }
+    const std::vector<std::string>& arguments() const { return entry_->second; }
+    bool operator==(const CompileFlags& rhs) const { return entry_ == rhs.entry_; }
+
+private:
+    using Interned = std::map<std::string, std::vector<std::string>, std::less<>>;  // nodes stay in place when it grows
+    static Interned& interned_flags()
+    {
+        static Interned interned{};
+        return interned;
+    }
+
+    const Interned::value_type* entry_{};
+};
 
 struct CompileJob
 {
     std::filesystem::path source_file;
     std::filesystem::path object_file;
-    std::string compile_flags;
-    uint64_t source_timestamp;
+    CompileFlags compile_flags;
+    FileStamp source_stamp;
+    std::vector<HeaderDependency> header_dependencies{};  // discovered by compiler, filled after compilation
+    std::filesystem::path precompiled_header{};  // used by this job, compilers don't report it in depfile
+    bool produces_precompiled_header{false};
+    std::filesystem::path module_output{};  // module interface produced by this job, known after dependency scan
+    bool uses_modules{false};  // module interfaces read and written are not part of compilation cache keys
 };
 
+// Input files are not compared here, they are checked separately against their recorded stamps
 bool operator==(const CompileJob& lhs, const CompileJob& rhs)
 {
     return lhs.source_file == rhs.source_file and
         lhs.object_file == rhs.object_file and
-        lhs.compile_flags == rhs.compile_flags and
-        lhs.source_timestamp == rhs.source_timestamp;
+        lhs.compile_flags == rhs.compile_flags;
 }
 
 struct LinkJob
@@ -63,29 +212,66 @@ struct LinkJob
     std::vector<std::filesystem::path> object_files;
     std::filesystem::path target_file;
     std::string link_flags;
+    std::vector<std::filesystem::path> libraries{};  // static libraries linked after object files
+};
+
+struct ArchiveJob
+{
+    std::vector<std::filesystem::path> object_files;  // members added or replaced, all of them when archive is rewritten
+    std::filesystem::path archive_file;
+    bool thin{false};  // archive only references object files instead of copying them
+    bool rewrite{false};  // archive was removed and members are appended without looking for ones to replace
 };
 
 struct Job
 {
-    std::variant<CompileJob, LinkJob> specific_job;
+    std::variant<CompileJob, LinkJob, ArchiveJob> specific_job;
     std::vector<size_t> depends_on;  // indices of jobs this job depends on
-    enum class Status { Pending, Running, Completed, Failed } status = Status::Pending;
+    enum class Status { Pending, Running, Completed, Failed, Skipped } status = Status::Pending;
     int exit_code = 0;
+    std::string target_name{};
+    std::string pool{};  // job pool limiting how many jobs of its kind run at once, no limit when empty
+    std::vector<std::string> environment{};  // NAME=VALUE entries overriding environment of nobs for this job only
+    std::filesystem::path working_directory{};  // directory job is started in, current one when empty
+};
+
+// Cost of header across all translation units of target, gathered from -H output during compilation
+struct HeaderCost
+{
+    std::filesystem::path header_file;
+    size_t inclusions{};  // times header was opened, summed over translation units
+    uint64_t included_bytes{};  // size of header and its nested headers, summed over inclusions
+    size_t translation_units{};  // translation units recompiled when header changes
 };
 } // namespace nobs::internal
 
 namespace nobs
 {
+enum class TargetType { Executable, StaticLibrary };
+
 struct Target
 {
     std::string name;
+    TargetType type{TargetType::Executable};
     std::vector<std::filesystem::path> sources;
     std::vector<std::string> compile_flags;
+    std::filesystem::path precompiled_header{};
+    bool uses_modules{false};
+    uint64_t unity_batch_milliseconds{0};  // unity build is disabled when 0
+    std::vector<std::filesystem::path> object_files{};
     std::vector<internal::Job> build_jobs{};
     bool needs_linking {false};
+    bool built {false};
+    std::string pool{};  // job pool of compile jobs
+    std::string link_pool{internal::default_link_pool};
+    std::vector<std::string> environment{};  // NAME=VALUE entries set for compiler and linker of target
+    std::filesystem::path working_directory{};  // compiler and linker are started there, relative paths in flags are resolved against it
+    std::vector<internal::HeaderCost> header_costs{};  // ranked by included bytes, filled when include report is enabled
+    std::vector<std::string> linked_libraries{};  // names of static library targets, in link order
+    bool thin_archive{false};
 
     Target() = default;
-    Target(const std::string_view& target_name) : name(target_name) {}
+    Target(const std::string_view& target_name, const TargetType target_type = TargetType::Executable) : name(target_name), type(target_type) {}
 
     Target(Target&& rhs) = default;
     Target& operator=(Target&& rhs) = default;
@@ -99,381 +285,3873 @@ protected:
 namespace nobs::internal
 {
 
-static std::vector<Target> targets {};
+// Path of cgroup v2 this process runs in, relative to cgroup root
+std::optional<std::filesystem::path> find_own_cgroup()
+{
+    std::ifstream cgroup_file{"/proc/self/cgroup"};
+    std::string line{};
+    while (std::getline(cgroup_file, line))
+    {
+        if (line.starts_with("0::"))
+        {
+            return std::filesystem::path{line.substr(3)}.relative_path();
+        }
+    }
+    return std::nullopt;  // cgroup v1 hierarchy only
+}
+
+// CPU quota of cgroup v2 this process runs in, the strictest one of its ancestors applies as well
+std::optional<double> read_cgroup_cpu_limit()
+{
+    const auto own_cgroup = find_own_cgroup();
+    if (not own_cgroup)
+    {
+        return std::nullopt;
+    }
+
+    std::optional<double> limit{};
+    auto cgroup = std::filesystem::path{cgroup_root_directory};
+    for (const auto& part : *own_cgroup)
+    {
+        cgroup /= part;
+        std::ifstream cpu_max{cgroup / "cpu.max"};
+        std::string quota{};
+        double period{};
+        if (cpu_max >> quota >> period and quota != "max" and period > 0)
+        {
+            limit = std::min(limit.value_or(std::stod(quota) / period), std::stod(quota) / period);
+        }
+    }
+    return limit;
+}
+
+// Never 0, even when hardware_concurrency can't tell; affinity mask and container CPU quota are respected
+size_t detect_parallel_jobs()
+{
+    size_t cpus = std::thread::hardware_concurrency();
+    cpu_set_t cpu_set{};
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0)
+    {
+        cpus = static_cast<size_t>(CPU_COUNT(&cpu_set));
+    }
+    if (const auto cpu_limit = read_cgroup_cpu_limit())
+    {
+        cpus = std::min(cpus, static_cast<size_t>(std::ceil(*cpu_limit)));
+    }
+    return std::max<size_t>(cpus, 1);
+}
+
+static std::deque<Target> targets {};  // deque keeps references returned by add_executable valid
 static std::filesystem::path build_directory {default_build_directory};  // build in "build_dir" by default
 static std::filesystem::path project_directory {std::filesystem::current_path()};
 static bool clean_mode{false};
-static size_t parallel_jobs = std::thread::hardware_concurrency();
+static bool content_hashing{false};
+static std::filesystem::path cache_directory{};  // compilation cache is disabled when empty
+static bool suggest_precompiled_headers{false};
+static bool unity_builds_enabled{true};
+static size_t parallel_jobs = detect_parallel_jobs();
+static bool adaptive_jobs{false};  // parallel_jobs is upper limit, lowered while system is under pressure
+static uint64_t memory_limit_kib{0};  // jobs are admitted while their predicted peak memory fits, 0 means no limit
+static bool jobserver_enabled{false};  // nobs serves its job slots to compilers it runs, unless it is client of other jobserver
+static std::map<std::string, size_t> job_pools{};  // maximum number of running jobs of every pool
+static size_t response_file_threshold{default_response_file_threshold};  // response files are not used when 0
+static size_t max_failed_jobs{1};  // no new jobs are started after that many failures, 0 means keep going
+static bool time_report{false};
+static bool include_report{false};
+static bool direct_compilation{false};
+static std::filesystem::path trace_file{};  // build timeline is not recorded when empty
 
 struct PendingJob {
     size_t job_index;
     pid_t pid;
     std::string command_display;
     bool is_compile_job;
+    std::string cache_key{};  // direct mode key of compilation cache, empty when not cached
+    std::chrono::steady_clock::time_point start_time{};
+    uint64_t start_timestamp{};  // file time when job was started, inputs modified since then are not up to date in its output
+    size_t slot{};  // index of parallel job slot, shown as separate track in build trace
+    int pidfd{-1};  // becomes readable when process exits, -1 when kernel does not support it
+    int output_fd{-1};  // read end of pipe connected to stdout and stderr of job, -1 when closed
+    std::string output{};
 };
 
-void set_parallel_jobs(size_t num_jobs)
+int open_pidfd(pid_t pid)
 {
-    parallel_jobs = num_jobs > 0 ? num_jobs : 1;
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    return -1;
+#endif
 }
 
-void trace_error(const std::string_view& error_string, const std::source_location location = std::source_location::current())
+static int child_exit_pipe[2]{-1, -1};  // SIGCHLD handler writes to it, so exits are noticed without pidfds too
+
+void notify_child_exit(int)
 {
-    std::println("{}Error at {}:{}: {}{}", RED_FONT, location.file_name(), location.line(), error_string, RESET_FONT);
+    const auto saved_errno = errno;
+    [[maybe_unused]] const auto written = write(child_exit_pipe[1], "", 1);  // full pipe already wakes poll up
+    errno = saved_errno;
 }
 
-inline std::vector<char*> build_argv(const std::vector<std::string>& args)
+void drain_child_exit_pipe()
 {
-    std::vector<char*> argv;
-    for (const auto& arg : args)
-    {
-        argv.push_back(const_cast<char*>(arg.c_str()));
-    }
-    argv.push_back(nullptr);
-    return argv;
+    char buffer[256];
+    while (read(child_exit_pipe[0], buffer, sizeof(buffer)) > 0) {}
 }
 
-int execute_command(const std::vector<std::string>& args)
+// Reads whatever job has written so far, closes pipe when job and its children closed it
+void read_job_output(PendingJob& pending_job)
 {
-    pid_t pid = fork();
-    if (pid == -1)
-    {
-        trace_error("Failed to fork process");
-        exit(-1);
-    }
-
-    if (pid == 0)
-    {
-        // Child process
-        auto argv = build_argv(args);
-        execvp(argv[0], argv.data());
-        // If execvp returns, an error occurred
-        trace_error("Failed to execute command");
-        exit(-1);
-    }
-    else
+    char buffer[4096];
+    while (pending_job.output_fd != -1)
     {
-        // Parent process
-        int status;
-        waitpid(pid, &status, 0);
-        if (WIFEXITED(status))
+        const auto count = read(pending_job.output_fd, buffer, sizeof(buffer));
+        if (count > 0)
         {
-            return WEXITSTATUS(status);
+            pending_job.output.append(buffer, static_cast<size_t>(count));
         }
-        else
+        else if (count == -1 and errno == EAGAIN)
+        {
+            return;  // pipe is empty for now
+        }
+        else if (count == 0 or errno != EINTR)
         {
-            trace_error("Child process did not terminate normally");
-            return -1;
+            close(pending_job.output_fd);  // on error as well, poll would keep reporting it otherwise
+            pending_job.output_fd = -1;
         }
     }
 }
 
-bool are_dependencies_satisfied(const std::vector<Job>& jobs, size_t job_index)
+// Collects output of pending jobs until any of them finishes, without reaping it, wake descriptor becomes readable, or until timeout
+void wait_for_job_events(std::vector<PendingJob>& pending_jobs, const int timeout_milliseconds = -1, const int wake_fd = -1)
 {
-    const auto& job = jobs[job_index];
-    for (size_t dep_index : job.depends_on)
+    while (true)
     {
-        if (jobs[dep_index].status != Job::Status::Completed)
+        std::vector<pollfd> descriptors{};
+        std::vector<PendingJob*> output_jobs{};
+        for (auto& pending_job : pending_jobs)
         {
-            return false;
+            if (pending_job.output_fd != -1)
+            {
+                descriptors.push_back(pollfd{.fd = pending_job.output_fd, .events = POLLIN, .revents = 0});
+                output_jobs.push_back(&pending_job);
+            }
         }
-    }
-    return true;
-}
+        for (const auto& pending_job : pending_jobs)
+        {
+            descriptors.push_back(pollfd{.fd = pending_job.pidfd, .events = POLLIN, .revents = 0});
+        }
+        // Exit of job without pidfd is noticed through SIGCHLD handler, bytes written before poll keep it from sleeping
+        descriptors.push_back(pollfd{.fd = child_exit_pipe[0], .events = POLLIN, .revents = 0});
+        descriptors.push_back(pollfd{.fd = wake_fd, .events = POLLIN, .revents = 0});
 
-inline void print_job_status(int percent, size_t ordinal, size_t total, std::string_view color, std::string_view type, const std::string& command_display)
-{
-    std::println("[{:3}%] {}/{} {}{} {}{}", percent, ordinal, total, color, type, command_display, RESET_FONT);
-}
+        const auto ready = poll(descriptors.data(), descriptors.size(), timeout_milliseconds);
+        if (ready == -1)
+        {
+            continue;  // EINTR
+        }
+        if (ready == 0)
+        {
+            return;
+        }
 
-inline std::pair<std::vector<std::string>, bool> build_job_command_args(const Job& job)
-{
-    std::vector<std::string> args;
-    if (std::holds_alternative<CompileJob>(job.specific_job))
-    {
-        auto specific_job = std::get<CompileJob>(job.specific_job);
-        args.push_back(compiler);
-        std::istringstream iss(specific_job.compile_flags);
-        std::string flag;
-        while (iss >> flag)
+        for (size_t index = 0; index < output_jobs.size(); ++index)
         {
-            args.push_back(flag);
+            if (descriptors[index].revents != 0)
+            {
+                read_job_output(*output_jobs[index]);
+            }
         }
-        args.push_back(compile_flag);
-        args.push_back(compile_output_flag);
-        args.push_back(specific_job.object_file.string());
-        args.push_back(specific_job.source_file.string());
-        return {args, true};
-    }
-    else
-    {
-        auto specific_job = std::get<LinkJob>(job.specific_job);
-        args.push_back(compiler);
-        args.push_back(linker_output_flag);
-        args.push_back(specific_job.target_file.string());
-        for (const auto& object : specific_job.object_files)
+        const auto exited = std::ranges::any_of(descriptors | std::views::drop(output_jobs.size()),
+            [](const pollfd& descriptor) { return descriptor.revents != 0; });
+        if (exited)
         {
-            args.push_back(object.string());
+            drain_child_exit_pipe();
+            return;
         }
-        return {args, false};
     }
 }
 
-inline std::string join_command_display(const std::vector<std::string>& args)
+void set_parallel_jobs(size_t num_jobs)
 {
-    std::string out;
-    for (const auto& a : args) { out += a; out += ' '; }
-    return out;
+    parallel_jobs = num_jobs > 0 ? num_jobs : 1;
 }
 
-inline int compute_percent(size_t completed, size_t pending, size_t jobs_count)
+void trace_error(const std::string_view& error_string, const std::source_location location = std::source_location::current())
 {
-    return static_cast<int>((completed + pending + 1) * 100 / jobs_count);
+    std::println("{}Error at {}:{}: {}{}", RED_FONT, location.file_name(), location.line(), error_string, RESET_FONT);
 }
 
-void create_directory_if_missing(const std::filesystem::path& directory)
+// Slice of build timeline, exported in Chrome trace event format viewable in Perfetto or chrome://tracing
+struct TraceEvent
 {
-    try
-    { 
-        std::filesystem::create_directories(directory);
-    }
-    catch (std::filesystem::filesystem_error& error)
+    std::string name;
+    std::string category;
+    size_t track;  // 0 is nobs itself, job slots follow
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+    std::vector<std::pair<std::string, std::string>> args{};
+};
+
+static const auto trace_start = std::chrono::steady_clock::now();
+static std::vector<TraceEvent> trace_events{};
+static size_t trace_tracks_count{1};
+
+void record_trace_event(TraceEvent event)
+{
+    if (trace_file.empty())
     {
-        trace_error(std::format("ERROR: got {} - code {}", error.what(), error.code().message()));
-        throw;
+        return;
     }
+    trace_tracks_count = std::max(trace_tracks_count, event.track + 1);
+    trace_events.push_back(std::move(event));
 }
 
-CompileJob read_compile_job_from_file(const std::filesystem::path& job_metafile)
+// Records nobs phase lasting until end of scope
+struct TraceScope
 {
-    std::string job_metafile_name = job_metafile.string();
-    std::ifstream file{job_metafile_name};
+    std::string name;
+    std::string target_name;
+    std::chrono::steady_clock::time_point start{std::chrono::steady_clock::now()};
 
-    if (not file)
+    ~TraceScope()
     {
-        trace_error(std::format("Error opening file {}", job_metafile_name), std::source_location::current());
-        exit(1);
+        record_trace_event({name, "nobs", 0, start, std::chrono::steady_clock::now(), {{"target", target_name}}});
     }
+};
 
-    CompileJob job{};
-
-    std::string line{};
-
-    if (not std::getline(file, line)) {
-        trace_error(std::format("Could not read source file from metafile {}", job_metafile_name));
-        exit(1);
+std::string escape_json_string(const std::string_view& text)
+{
+    std::string escaped{};
+    for (const char character : text)
+    {
+        switch (character)
+        {
+            case '"': escaped.append("\\\""); break;
+            case '\\': escaped.append("\\\\"); break;
+            case '\n': escaped.append("\\n"); break;
+            case '\t': escaped.append("\\t"); break;
+            default:
+                if (static_cast<unsigned char>(character) < 0x20) escaped.append(std::format("\\u{:04x}", static_cast<int>(character)));
+                else escaped.push_back(character);
+        }
     }
-    job.source_file = line.c_str();
+    return escaped;
+}
 
-    if (not std::getline(file, line)) {
-        trace_error(std::format("Could not read object source file from metafile {}", job_metafile_name));
-        exit(1);
-    }
-    job.object_file = line.c_str();
+// Registered with atexit, so timeline of failed builds is written as well
+void write_trace_file()
+{
+    const auto microseconds = [](const std::chrono::steady_clock::time_point time)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time - trace_start).count();
+    };
 
-    if (not std::getline(file, line)) {
-        trace_error(std::format("Could not read compiler flags from metafile {}", job_metafile_name));
-        exit(1);
+    std::ofstream file{trace_file};
+    if (not file)
+    {
+        trace_error(std::format("Could not write build trace {}", trace_file.string()));
+        return;
     }
-    job.compile_flags = line.c_str();
 
-    if (not std::getline(file, line)) {
-        trace_error(std::format("Could not read timestamp from metafile {}", job_metafile_name));
-        exit(1);
+    std::println(file, "{{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (size_t track = 0; track < trace_tracks_count; ++track)
+    {
+        const auto track_name = track == 0 ? std::string{"nobs"} : std::format("slot {}", track);
+        std::println(file, "{{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": {}, \"args\": {{\"name\": \"{}\"}}}},", track, track_name);
+    }
+    for (const auto& event : trace_events)
+    {
+        std::string args{};
+        for (const auto& [key, value] : event.args)
+        {
+            args.append(std::format("{}\"{}\": \"{}\"", args.empty() ? "" : ", ", escape_json_string(key), escape_json_string(value)));
+        }
+        std::println(file, "{{\"ph\": \"X\", \"name\": \"{}\", \"cat\": \"{}\", \"pid\": 1, \"tid\": {}, \"ts\": {}, \"dur\": {}, \"args\": {{{}}}}},",
+            escape_json_string(event.name), event.category, event.track, microseconds(event.start), microseconds(event.end) - microseconds(event.start), args);
     }
-    job.source_timestamp = std::stoull(line.c_str());
-    return job;
+    std::println(file, "{{\"ph\": \"M\", \"name\": \"process_name\", \"pid\": 1, \"args\": {{\"name\": \"nobs\"}}}}");
+    std::println(file, "]}}");
 }
 
-auto get_file_metafile_name(const std::filesystem::path& source_file, const std::filesystem::path& build_source_path)
+inline std::vector<char*> build_argv(const std::vector<std::string>& args)
 {
-    auto meta_file = std::filesystem::canonical(build_source_path);
-    meta_file /= source_file.filename();
-    meta_file += metafile_extension;
-    return meta_file;
+    std::vector<char*> argv;
+    for (const auto& arg : args)
+    {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    return argv;
 }
 
-void write_compile_job_to_file(const CompileJob& compile_job)
+// Environment of nobs with overriding NAME=VALUE entries replacing or extending its variables
+std::vector<std::string> build_environment(const std::vector<std::string>& overrides)
 {
-    const auto meta_file = compile_job.object_file.string() + metafile_extension;
-    if (std::ofstream file{meta_file.c_str()}; file) {
-        std::println(file, "{}", compile_job.source_file.string());
-        std::println(file, "{}", compile_job.object_file.string());
-        std::println(file, "{}", compile_job.compile_flags);
-        std::println(file, "{}", compile_job.source_timestamp);
-    } else {
-        trace_error("Error opening file!");
-        exit(-1);
-    } 
+    std::vector<std::string> environment{};
+    for (char** variable = environ; *variable != nullptr; ++variable)
+    {
+        const std::string_view entry{*variable};
+        const auto name = entry.substr(0, entry.find('=') + 1);
+        if (std::ranges::none_of(overrides, [&](const auto& item) { return item.starts_with(name); }))
+        {
+            environment.emplace_back(entry);
+        }
+    }
+    environment.insert(environment.end(), overrides.begin(), overrides.end());
+    return environment;
 }
 
-uint64_t get_file_timestamp(const std::filesystem::path& filename)
+// posix_spawn starts child with vfork-like clone sharing memory of nobs, so unlike fork no page tables are copied
+// and spawn latency stays flat however big job graph gets. Only stdio and output_fd (as stdout and stderr) are
+// meant to be inherited, all other descriptors of nobs have to be close-on-exec. Returns -1 when command can't be started.
+pid_t spawn_process(const std::vector<std::string>& args, const int output_fd = -1, const std::vector<std::string>& environment = {},
+    const std::filesystem::path& working_directory = {})
 {
-    if (std::filesystem::exists(filename))
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    if (output_fd != -1)
     {
-        return static_cast<uint64_t>(std::filesystem::last_write_time(filename).time_since_epoch().count());
+        posix_spawn_file_actions_adddup2(&file_actions, output_fd, STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&file_actions, output_fd, STDERR_FILENO);
     }
-    else
+    if (not working_directory.empty())
     {
-        return 0;
+        posix_spawn_file_actions_addchdir_np(&file_actions, working_directory.c_str());
+    }
+
+    const auto merged_environment = environment.empty() ? std::vector<std::string>{} : build_environment(environment);
+    auto envp = build_argv(merged_environment);
+    auto argv = build_argv(args);
+    pid_t pid{};
+    const int error = posix_spawnp(&pid, argv[0], &file_actions, nullptr, argv.data(), environment.empty() ? environ : envp.data());
+    posix_spawn_file_actions_destroy(&file_actions);
+    if (error != 0)
+    {
+        trace_error(std::format("Failed to execute {}: {}", args.front(), std::strerror(error)));
+        return -1;
     }
+    return pid;
 }
 
-void prepare_file_compilation(Target& target, const std::string& flags, const bool use_build_dir, const std::filesystem::path& source)
+int execute_command(const std::vector<std::string>& args)
 {
-    create_directory_if_missing(build_directory);
-    auto canonical_build_dir = std::filesystem::canonical(build_directory);
+    const pid_t pid = spawn_process(args);
+    if (pid == -1)
+    {
+        return -1;
+    }
 
-    std::filesystem::path relative_source_path{};
-    if (source.is_absolute())
+    int status;
+    waitpid(pid, &status, 0);
+    if (WIFEXITED(status))
     {
-        relative_source_path = std::filesystem::relative(source, project_directory);
+        return WEXITSTATUS(status);
     }
     else
     {
-        relative_source_path = source;
+        trace_error("Child process did not terminate normally");
+        return -1;
     }
+}
 
-    auto build_source_file = canonical_build_dir / relative_source_path;
-    auto build_source_path = build_source_file.parent_path();
-
-    if (use_build_dir)  
+std::pair<int, std::string> execute_command_with_output(const std::vector<std::string>& args)
+{
+    int output_pipe[2];
+    if (pipe2(output_pipe, O_CLOEXEC) == -1)
     {
-        create_directory_if_missing(build_source_path);
+        trace_error("Failed to create pipe");
+        exit(-1);
     }
-    else   
+
+    const pid_t pid = spawn_process(args, output_pipe[1]);
+    close(output_pipe[1]);
+    if (pid == -1)
     {
-        build_source_file = source;
-        build_source_path = ".";
+        close(output_pipe[0]);
+        return {-1, std::string{}};
     }
 
-    auto object_file = std::filesystem::canonical(build_source_path);
-
-    object_file /= source.filename();
-    object_file = std::filesystem::path{object_file.string() + object_file_extension};
-
-    auto metafile_name = get_file_metafile_name(object_file, build_source_path);
-    
-    CompileJob new_compile_job{
-        .source_file = relative_source_path,
-        .object_file = object_file,
-        .compile_flags = flags,
-        .source_timestamp = get_file_timestamp(source),
-    };
-    
-    if (std::filesystem::exists(metafile_name))
+    std::string output{};
+    char buffer[4096];
+    for (ssize_t count = read(output_pipe[0], buffer, sizeof(buffer)); count != 0; count = read(output_pipe[0], buffer, sizeof(buffer)))
     {
-        auto old_compile_job = read_compile_job_from_file(metafile_name);
-        if (old_compile_job == new_compile_job)
+        if (count == -1)
         {
-            // TODO add verbosity level to print that file is up to date
-            return;
+            if (errno == EINTR) continue;
+            break;
         }
+        output.append(buffer, static_cast<size_t>(count));
     }
+    close(output_pipe[0]);
 
-    target.needs_linking = true;
-    target.build_jobs.push_back(Job{new_compile_job});
+    int status;
+    waitpid(pid, &status, 0);
+    return {WIFEXITED(status) ? WEXITSTATUS(status) : -1, output};
 }
 
-void prepare_target_compilation(Target& target, const bool use_build_dir = true)
+// Calls function for every index in [0, count) from up to parallel_jobs threads
+void for_each_in_parallel(size_t count, const std::function<void(size_t)>& function)
 {
-    create_directory_if_missing(build_directory);
-    
-    std::string flags{};
-    for (const auto & flag : target.compile_flags)
-    {  
-        flags.append(std::format("{} ", flag));
-    }
+    std::atomic<size_t> next_index{0};
+    auto worker = [&]()
+    {
+        for (size_t index = next_index++; index < count; index = next_index++)
+        {
+            function(index);
+        }
+    };
 
-    for (const auto& source : target.sources)
-    {    
-        prepare_file_compilation(target, flags, use_build_dir, source);
+    std::vector<std::jthread> workers{};
+    const auto workers_count = std::min(parallel_jobs, count);
+    for (size_t i = 1; i < workers_count; ++i)
+    {
+        workers.emplace_back(worker);
     }
+    worker();
 }
 
-void prepare_target_linking(Target& target, const bool use_build_dir = true)
+struct JsonValue
 {
-    if (not target.needs_linking)
+    using Array = std::vector<JsonValue>;
+    using Object = std::vector<std::pair<std::string, JsonValue>>;
+    std::variant<std::nullptr_t, bool, double, std::string, Array, Object> value{};
+
+    const JsonValue* find(const std::string_view& key) const
     {
-        return;
+        if (const auto* object = std::get_if<Object>(&value))
+        {
+            for (const auto& [member_key, member_value] : *object)
+            {
+                if (member_key == key) return &member_value;
+            }
+        }
+        return nullptr;
     }
 
-    auto canonical_build_dir = std::filesystem::canonical(build_directory);
-    if (not use_build_dir) canonical_build_dir = std::filesystem::canonical(current_directory);
+    const std::string* as_string() const { return std::get_if<std::string>(&value); }
+    const Array* as_array() const { return std::get_if<Array>(&value); }
+    double as_number() const { return std::holds_alternative<double>(value) ? std::get<double>(value) : 0.0; }
+};
 
-    auto link_job = LinkJob{};
+// Small recursive descent parser, good enough for compiler generated files
+class JsonParser
+{
+public:
+    explicit JsonParser(const std::string_view& text) : text_(text) {}
+
+    std::optional<JsonValue> parse()
+    {
+        auto value = parse_value();
+        skip_whitespace();
+        if (not value or position_ != text_.size())
+        {
+            return std::nullopt;
+        }
+        return value;
+    }
+
+private:
+    std::optional<JsonValue> parse_value()
+    {
+        skip_whitespace();
+        if (position_ >= text_.size()) return std::nullopt;
+
+        switch (text_[position_])
+        {
+            case '{': return parse_object();
+            case '[': return parse_array();
+            case '"':
+            {
+                auto string = parse_string();
+                if (not string) return std::nullopt;
+                return JsonValue{std::move(*string)};
+            }
+            case 't': return parse_literal("true", JsonValue{true});
+            case 'f': return parse_literal("false", JsonValue{false});
+            case 'n': return parse_literal("null", JsonValue{nullptr});
+            default: return parse_number();
+        }
+    }
+
+    std::optional<JsonValue> parse_object()
+    {
+        JsonValue::Object object{};
+        ++position_;
+        skip_whitespace();
+        if (consume('}')) return JsonValue{std::move(object)};
+
+        do
+        {
+            skip_whitespace();
+            auto key = parse_string();
+            skip_whitespace();
+            if (not key or not consume(':')) return std::nullopt;
+            auto value = parse_value();
+            if (not value) return std::nullopt;
+            object.emplace_back(std::move(*key), std::move(*value));
+            skip_whitespace();
+        } while (consume(','));
+
+        if (not consume('}')) return std::nullopt;
+        return JsonValue{std::move(object)};
+    }
+
+    std::optional<JsonValue> parse_array()
+    {
+        JsonValue::Array array{};
+        ++position_;
+        skip_whitespace();
+        if (consume(']')) return JsonValue{std::move(array)};
+
+        do
+        {
+            auto value = parse_value();
+            if (not value) return std::nullopt;
+            array.push_back(std::move(*value));
+            skip_whitespace();
+        } while (consume(','));
+
+        if (not consume(']')) return std::nullopt;
+        return JsonValue{std::move(array)};
+    }
+
+    std::optional<std::string> parse_string()
+    {
+        if (not consume('"')) return std::nullopt;
+
+        std::string string{};
+        while (position_ < text_.size() and text_[position_] != '"')
+        {
+            char character = text_[position_++];
+            if (character != '\\')
+            {
+                string.push_back(character);
+                continue;
+            }
+            if (position_ >= text_.size()) return std::nullopt;
+
+            switch (const char escaped = text_[position_++])
+            {
+                case 'b': string.push_back('\b'); break;
+                case 'f': string.push_back('\f'); break;
+                case 'n': string.push_back('\n'); break;
+                case 'r': string.push_back('\r'); break;
+                case 't': string.push_back('\t'); break;
+                case 'u':
+                {
+                    if (position_ + 4 > text_.size()) return std::nullopt;
+                    unsigned long code_point{};
+                    const auto digits = text_.data() + position_;
+                    if (std::from_chars(digits, digits + 4, code_point, 16).ptr != digits + 4) return std::nullopt;
+                    position_ += 4;
+                    append_utf8(string, code_point);
+                    break;
+                }
+                default: string.push_back(escaped); break;
+            }
+        }
+
+        if (not consume('"')) return std::nullopt;
+        return string;
+    }
+
+    std::optional<JsonValue> parse_number()
+    {
+        const auto start = position_;
+        while (position_ < text_.size() and (std::isdigit(static_cast<unsigned char>(text_[position_])) or
+            text_[position_] == '-' or text_[position_] == '+' or text_[position_] == '.' or text_[position_] == 'e' or text_[position_] == 'E'))
+        {
+            ++position_;
+        }
+        if (start == position_) return std::nullopt;
+        return JsonValue{std::strtod(std::string{text_.substr(start, position_ - start)}.c_str(), nullptr)};
+    }
+
+    std::optional<JsonValue> parse_literal(const std::string_view& literal, JsonValue value)
+    {
+        if (text_.substr(position_, literal.size()) != literal) return std::nullopt;
+        position_ += literal.size();
+        return value;
+    }
+
+    static void append_utf8(std::string& string, unsigned long code_point)
+    {
+        if (code_point < 0x80)
+        {
+            string.push_back(static_cast<char>(code_point));
+        }
+        else if (code_point < 0x800)
+        {
+            string.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+            string.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        }
+        else
+        {
+            string.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+            string.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            string.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        }
+    }
+
+    bool consume(char expected)
+    {
+        if (position_ < text_.size() and text_[position_] == expected)
+        {
+            ++position_;
+            return true;
+        }
+        return false;
+    }
+
+    void skip_whitespace()
+    {
+        while (position_ < text_.size() and std::isspace(static_cast<unsigned char>(text_[position_])))
+        {
+            ++position_;
+        }
+    }
+
+    std::string_view text_;
+    size_t position_{0};
+};
+
+std::string read_file_content(const std::filesystem::path& filename)
+{
+    std::ifstream file{filename, std::ios::binary};
+    std::ostringstream content{};
+    content << file.rdbuf();
+    return content.str();
+}
+
+bool are_dependencies_satisfied(const std::vector<Job>& jobs, size_t job_index)
+{
+    const auto& job = jobs[job_index];
+    for (size_t dep_index : job.depends_on)
+    {
+        if (jobs[dep_index].status != Job::Status::Completed)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline void print_job_status(int percent, size_t ordinal, size_t total, std::string_view color, std::string_view type, const std::string& command_display)
+{
+    std::println("[{:3}%] {}/{} {}{} {}{}", percent, ordinal, total, color, type, command_display, RESET_FONT);
+}
+
+inline void append_flags(std::vector<std::string>& args, const CompileFlags& flags)
+{
+    args.insert(args.end(), flags.arguments().begin(), flags.arguments().end());
+}
+
+bool is_clang_compiler()
+{
+    return compiler.find("clang") != std::string::npos;
+}
+
+// Compilers don't recognize all extensions used for module interface units
+bool is_module_interface_source(const std::filesystem::path& source)
+{
+    const auto extension = source.extension();
+    return extension == ".cppm" or extension == ".ixx" or extension == ".mpp" or extension == ".cxxm" or extension == ".c++m";
+}
+
+inline void append_source_language(std::vector<std::string>& args, const std::filesystem::path& source)
+{
+    if (is_module_interface_source(source))
+    {
+        args.push_back(language_flag);
+        args.push_back(is_clang_compiler() ? cpp_module_language : cpp_language);
+    }
+}
+
+inline std::pair<std::vector<std::string>, bool> build_job_command_args(const Job& job)
+{
+    std::vector<std::string> args;
+    if (std::holds_alternative<CompileJob>(job.specific_job))
+    {
+        const auto& specific_job = std::get<CompileJob>(job.specific_job);
+        args.reserve(specific_job.compile_flags.arguments().size() + 12);
+        args.push_back(compiler);
+        append_flags(args, specific_job.compile_flags);
+        if (include_report)
+        {
+            args.push_back(include_tree_flag);
+        }
+        if (time_report)
+        {
+            args.push_back(is_clang_compiler() ? std::format("-ftime-trace={}{}", specific_job.object_file.string(), time_trace_extension) : "-ftime-report");
+        }
+        if (not specific_job.module_output.empty() and is_clang_compiler())
+        {
+            args.push_back(std::format("-fmodule-output={}", specific_job.module_output.string()));
+        }
+        if (specific_job.produces_precompiled_header)
+        {
+            args.push_back(language_flag);
+            args.push_back(precompiled_header_language);
+        }
+        else
+        {
+            args.push_back(compile_flag);
+        }
+        args.push_back(depfile_generation_flag);
+        args.push_back(depfile_output_flag);
+        args.push_back(specific_job.object_file.string() + depfile_extension);
+        args.push_back(compile_output_flag);
+        args.push_back(specific_job.object_file.string());
+        append_source_language(args, specific_job.source_file);
+        // Sources are relative to project directory, unlike object files
+        args.push_back(job.working_directory.empty() ? specific_job.source_file.string() : std::filesystem::absolute(specific_job.source_file).string());
+        return {args, true};
+    }
+    else if (const auto* archive_job = std::get_if<ArchiveJob>(&job.specific_job))
+    {
+        args.reserve(archive_job->object_files.size() + 4);
+        args.push_back(archiver);
+        if (archive_job->thin)
+        {
+            args.push_back(thin_archive_flag);
+        }
+        // Thin archive members are matched by full path (P), regular ones only by file name
+        args.push_back(std::format("{}cs{}", archive_job->rewrite ? 'q' : 'r', archive_job->thin ? "P" : ""));
+        args.push_back(archive_job->archive_file.string());
+        for (const auto& object : archive_job->object_files)
+        {
+            args.push_back(object.string());
+        }
+        return {args, false};
+    }
+    else
+    {
+        const auto& specific_job = std::get<LinkJob>(job.specific_job);
+        args.reserve(specific_job.object_files.size() + specific_job.libraries.size() + 3);
+        args.push_back(compiler);
+        args.push_back(linker_output_flag);
+        args.push_back(specific_job.target_file.string());
+        for (const auto& object : specific_job.object_files)
+        {
+            args.push_back(object.string());
+        }
+        for (const auto& library : specific_job.libraries)
+        {
+            args.push_back(library.string());
+        }
+        return {args, false};
+    }
+}
+
+inline std::string join_command_display(const std::vector<std::string>& args)
+{
+    std::string out;
+    for (const auto& a : args) { out += a; out += ' '; }
+    return out;
+}
+
+// One argument per line, whitespace, quotes and backslashes escaped the way gcc and clang read @file
+std::string format_response_file(const std::span<const std::string> args)
+{
+    std::string content{};
+    for (const auto& arg : args)
+    {
+        for (const char character : arg)
+        {
+            if (std::isspace(static_cast<unsigned char>(character)) or character == '\\' or character == '"' or character == '\'')
+            {
+                content += '\\';
+            }
+            content += character;
+        }
+        content += '\n';
+    }
+    return content;
+}
+
+// Replaces all arguments after program with @file once command line gets longer than threshold. File is rewritten
+// only when its content changes, so exec doesn't have to copy huge argv and unchanged file keeps its timestamp.
+void use_response_file(std::vector<std::string>& args, const std::filesystem::path& output)
+{
+    const auto length = std::accumulate(args.begin(), args.end(), size_t{0}, [](const size_t sum, const auto& arg) { return sum + arg.size() + 1; });
+    if (response_file_threshold == 0 or length <= response_file_threshold or args.size() < 2)
+    {
+        return;
+    }
+
+    const auto response_file = output.string() + response_file_extension;
+    const auto content = format_response_file(std::span{args}.subspan(1));
+    if (read_file_content(response_file) != content)
+    {
+        if (std::ofstream file{response_file, std::ios::binary | std::ios::trunc}; file)
+        {
+            std::print(file, "{}", content);
+        }
+        else
+        {
+            trace_error(std::format("Could not write response file {}", response_file));
+            exit(-1);
+        }
+    }
+    args.resize(1);
+    args.push_back("@" + response_file);
+}
+
+void create_directory_if_missing(const std::filesystem::path& directory)
+{
+    try
+    { 
+        std::filesystem::create_directories(directory);
+    }
+    catch (std::filesystem::filesystem_error& error)
+    {
+        trace_error(std::format("ERROR: got {} - code {}", error.what(), error.code().message()));
+        throw;
+    }
+}
+
+// Splits command line printed by driver for -###, arguments are quoted with \ escaping quotes and backslashes
+std::vector<std::string> parse_driver_command(const std::string_view& line)
+{
+    std::vector<std::string> args{};
+    for (size_t position = line.find('"'); position != std::string_view::npos; position = line.find('"', position + 1))
+    {
+        std::string arg{};
+        for (++position; position < line.size() and line[position] != '"'; ++position)
+        {
+            if (line[position] == '\\' and position + 1 < line.size())
+            {
+                ++position;
+            }
+            arg += line[position];
+        }
+        args.push_back(std::move(arg));
+    }
+    return args;
+}
+
+// Frontend command of placeholder compile job as driver would run it, when driver runs exactly one -cc1 process
+// (clang with integrated assembler). Anything else, like gcc running cc1plus and as, means driver has to stay.
+std::optional<std::vector<std::string>> expand_frontend_command(const std::vector<std::string>& driver_args)
+{
+    std::vector<std::string> args{driver_args.front(), driver_dry_run_flag};
+    args.insert(args.end(), driver_args.begin() + 1, driver_args.end());
+    const auto [exit_code, output] = execute_command_with_output(args);
+    if (exit_code != 0)
+    {
+        return std::nullopt;
+    }
+
+    std::vector<std::vector<std::string>> commands{};
+    std::istringstream lines{output};
+    for (std::string line{}; std::getline(lines, line); )
+    {
+        if (line.starts_with(" \""))
+        {
+            commands.push_back(parse_driver_command(line));
+        }
+    }
+
+    const auto has_placeholder = [&](const std::string_view& placeholder)
+    {
+        return std::ranges::any_of(commands.front(), [&](const auto& arg) { return arg.find(placeholder) != std::string::npos; });
+    };
+    if (commands.size() != 1 or commands.front().size() < 2 or commands.front()[1] != frontend_flag
+        or not has_placeholder(direct_compile_source) or not has_placeholder(direct_compile_object))
+    {
+        return std::nullopt;
+    }
+    return commands.front();
+}
+
+void replace_all(std::string& text, const std::string_view& from, const std::string_view& to)
+{
+    for (auto position = text.find(from); position != std::string::npos; position = text.find(from, position + to.size()))
+    {
+        text.replace(position, from.size(), to);
+    }
+}
+
+// Empty source driver is expanded for, it fails on inputs that do not exist
+std::filesystem::path get_direct_compile_source(const std::string& extension)
+{
+    return build_directory / (direct_compile_source + extension);
+}
+
+// Replaces driver command of compile job with frontend one, so one process less is started per translation unit.
+// Driver expands each flag set only once, for placeholder source and object substituted with real ones afterwards.
+void use_frontend_command(std::vector<std::string>& args, const Job& job)
+{
+    // Interned flags text identifies flag set, other compile job arguments depend only on these
+    using ExpansionKey = std::tuple<const std::string*, std::string, bool>;
+    static std::map<ExpansionKey, std::optional<std::vector<std::string>>> expanded_commands{};
+    const auto& compile_job = std::get<CompileJob>(job.specific_job);
+    if (not job.working_directory.empty() or not job.environment.empty() or not compile_job.module_output.empty())
+    {
+        return;  // driver would have to be expanded in environment of job
+    }
+
+    const auto extension = compile_job.source_file.extension().string();
+    const auto placeholder_source = get_direct_compile_source(extension).string();
+    const auto object_file = compile_job.object_file.string();
+    const ExpansionKey key{&compile_job.compile_flags.text(), extension, compile_job.produces_precompiled_header};
+    auto expanded = expanded_commands.find(key);
+    if (expanded == expanded_commands.end())
+    {
+        create_directory_if_missing(build_directory);
+        std::ofstream{placeholder_source};
+        auto placeholder_args = args;
+        for (auto& arg : placeholder_args)
+        {
+            replace_all(arg, object_file, direct_compile_object);
+        }
+        placeholder_args.back() = placeholder_source;  // source is always last
+        expanded = expanded_commands.emplace(key, expand_frontend_command(placeholder_args)).first;
+        if (not expanded->second)
+        {
+            std::println("{}Compiler driver can't be skipped for flags \"{}\", running it as usual.{}", YELLOW_FONT, compile_job.compile_flags.text(), RESET_FONT);
+        }
+    }
+    if (not expanded->second)
+    {
+        return;
+    }
+
+    args = *expanded->second;
+    for (size_t index = 0; index < args.size(); ++index)
+    {
+        if (index > 0 and args[index - 1] == "-main-file-name")
+        {
+            args[index] = compile_job.source_file.filename().string();
+            continue;
+        }
+        replace_all(args[index], placeholder_source, compile_job.source_file.string());
+        replace_all(args[index], direct_compile_object, object_file);
+    }
+}
+
+inline int compute_percent(size_t completed, size_t pending, size_t jobs_count)
+{
+    return static_cast<int>((completed + pending + 1) * 100 / jobs_count);
+}
+
+// Native encoding of records, state file is never shared between machines
+void append_record_value(std::string& record, const uint64_t value)
+{
+    record.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void append_record_string(std::string& record, const std::string_view& text)
+{
+    append_record_value(record, text.size());
+    record.append(text);
+}
+
+void append_record_stamp(std::string& record, const FileStamp& stamp)
+{
+    append_record_value(record, stamp.timestamp);
+    append_record_value(record, stamp.size);
+    append_record_value(record, stamp.inode);
+    append_record_value(record, stamp.content_hash);
+}
+
+// Reads record fields in place from mapped state file, becomes invalid instead of reading past record end
+class RecordReader
+{
+public:
+    explicit RecordReader(const std::string_view& record) : record_(record) {}
+
+    bool valid() const { return valid_; }
+
+    uint64_t read_value()
+    {
+        uint64_t value{};
+        if (position_ + sizeof(value) > record_.size())
+        {
+            valid_ = false;
+            return 0;
+        }
+        std::memcpy(&value, record_.data() + position_, sizeof(value));
+        position_ += sizeof(value);
+        return value;
+    }
+
+    std::string_view read_string()
+    {
+        const auto length = read_value();
+        if (not valid_ or length > record_.size() - position_)
+        {
+            valid_ = false;
+            return {};
+        }
+        const auto text = record_.substr(position_, length);
+        position_ += length;
+        return text;
+    }
+
+    FileStamp read_stamp()
+    {
+        return FileStamp{.timestamp = read_value(), .size = read_value(), .inode = read_value(), .content_hash = read_value()};
+    }
+
+private:
+    std::string_view record_;
+    size_t position_{};
+    bool valid_{true};
+};
+
+// Record is object file, source file, flags, source stamp and list of header dependencies
+std::string encode_compile_job(const CompileJob& compile_job)
+{
+    std::string record{};
+    append_record_string(record, compile_job.object_file.string());
+    append_record_string(record, compile_job.source_file.string());
+    append_record_string(record, compile_job.compile_flags.text());
+    append_record_stamp(record, compile_job.source_stamp);
+    append_record_value(record, compile_job.header_dependencies.size());
+    for (const auto& dependency : compile_job.header_dependencies)
+    {
+        append_record_string(record, dependency.header_file.string());
+        append_record_stamp(record, dependency.header_stamp);
+    }
+    return record;
+}
+
+std::optional<CompileJob> decode_compile_job(const std::string_view& record)
+{
+    RecordReader reader{record};
+    CompileJob compile_job{};
+    compile_job.object_file = reader.read_string();
+    compile_job.source_file = reader.read_string();
+    compile_job.compile_flags = CompileFlags{reader.read_string()};
+    compile_job.source_stamp = reader.read_stamp();
+    const auto headers_count = reader.read_value();
+    for (uint64_t index = 0; index < headers_count and reader.valid(); ++index)
+    {
+        HeaderDependency dependency{.header_file = reader.read_string()};
+        dependency.header_stamp = reader.read_stamp();
+        compile_job.header_dependencies.push_back(std::move(dependency));
+    }
+    if (not reader.valid())
+    {
+        return std::nullopt;
+    }
+    return compile_job;
+}
+
+// Compile jobs recorded by previous builds, kept in one memory mapped file of size prefixed records.
+// Records are only appended, the last one of every object file wins. File is compacted when opened,
+// if most of its records are outdated, and recreated when it was written by other nobs version.
+class BuildState
+{
+public:
+    explicit BuildState(const std::filesystem::path& state_file) : state_file_(state_file)
+    {
+        load();
+        if (records_count_ > compaction_threshold and records_count_ > 2 * records_.size())
+        {
+            compact();
+            load();
+        }
+    }
+
+    ~BuildState()
+    {
+        unmap();
+        if (append_fd_ != -1) close(append_fd_);
+    }
+
+    BuildState(const BuildState&) = delete;
+    BuildState& operator=(const BuildState&) = delete;
+
+    std::optional<CompileJob> find(const std::filesystem::path& object_file) const
+    {
+        if (const auto recorded_job = recorded_jobs_.find(object_file); recorded_job != recorded_jobs_.end())
+        {
+            return recorded_job->second;
+        }
+        if (const auto record = records_.find(object_file.string()); record != records_.end())
+        {
+            return decode_compile_job(record->second);
+        }
+        return std::nullopt;
+    }
+
+    void record(const CompileJob& compile_job)
+    {
+        if (append_fd_ == -1)
+        {
+            append_fd_ = open(state_file_.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        }
+
+        const auto payload = encode_compile_job(compile_job);
+        std::string record{};
+        append_record_value(record, payload.size());
+        record.append(payload);
+        if (append_fd_ == -1 or write(append_fd_, record.data(), record.size()) != static_cast<ssize_t>(record.size()))
+        {
+            trace_error(std::format("Could not record {} in build state {}", compile_job.object_file.string(), state_file_.string()));
+        }
+        recorded_jobs_[compile_job.object_file] = compile_job;
+    }
+
+private:
+    static constexpr size_t compaction_threshold = 1024;
+    static constexpr size_t header_size = build_state_magic.size() + sizeof(build_state_version);
+
+    void load()
+    {
+        unmap();
+        records_.clear();
+        records_count_ = 0;
+
+        const int fd = open(state_file_.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat file_stat{};
+        if (fd != -1 and fstat(fd, &file_stat) == 0 and static_cast<size_t>(file_stat.st_size) >= header_size)
+        {
+            size_ = static_cast<size_t>(file_stat.st_size);
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            data_ = data == MAP_FAILED ? nullptr : static_cast<const char*>(data);
+        }
+        if (fd != -1) close(fd);
+
+        const auto content = data_ ? std::string_view{data_, size_} : std::string_view{};
+        uint64_t version{};
+        if (content.size() >= header_size)
+        {
+            std::memcpy(&version, content.data() + build_state_magic.size(), sizeof(version));
+        }
+        if (not content.starts_with(build_state_magic) or version != build_state_version)
+        {
+            create_empty();
+            return;
+        }
+
+        size_t position = header_size;
+        while (position < content.size())
+        {
+            RecordReader record_size{content.substr(position)};
+            const auto payload_size = record_size.read_value();
+            if (not record_size.valid() or payload_size > content.size() - position - sizeof(payload_size))
+            {
+                break;
+            }
+            const auto payload = content.substr(position + sizeof(payload_size), payload_size);
+            RecordReader object_file{payload};
+            records_[object_file.read_string()] = payload;
+            records_count_++;
+            position += sizeof(payload_size) + payload_size;
+        }
+
+        // Record torn by interrupted build would hide all records appended after it
+        if (position != content.size())
+        {
+            truncate(state_file_.c_str(), static_cast<off_t>(position));
+        }
+    }
+
+    void create_empty()
+    {
+        unmap();
+        std::ofstream file{state_file_, std::ios::binary | std::ios::trunc};
+        file.write(build_state_magic.data(), build_state_magic.size());
+        file.write(reinterpret_cast<const char*>(&build_state_version), sizeof(build_state_version));
+    }
+
+    void compact()
+    {
+        const auto temporary_file = state_file_.string() + ".tmp";
+        {
+            std::ofstream file{temporary_file, std::ios::binary | std::ios::trunc};
+            file.write(build_state_magic.data(), build_state_magic.size());
+            file.write(reinterpret_cast<const char*>(&build_state_version), sizeof(build_state_version));
+            for (const auto& payload : records_ | std::views::values)
+            {
+                const uint64_t payload_size = payload.size();
+                file.write(reinterpret_cast<const char*>(&payload_size), sizeof(payload_size));
+                file.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+            }
+        }
+        std::filesystem::rename(temporary_file, state_file_);
+    }
+
+    void unmap()
+    {
+        if (data_)
+        {
+            munmap(const_cast<char*>(data_), size_);
+            data_ = nullptr;
+        }
+    }
+
+    std::filesystem::path state_file_;
+    const char* data_{nullptr};
+    size_t size_{};
+    int append_fd_{-1};
+    size_t records_count_{};
+    std::map<std::string_view, std::string_view> records_{};  // object file to its last record, pointing into mapped file
+    std::map<std::filesystem::path, CompileJob> recorded_jobs_{};  // recorded during this run, not visible in mapping
+};
+
+// Objects of nobs build script itself are built outside of build directory and keep their own state
+BuildState& get_build_state(const std::filesystem::path& object_file)
+{
+    static std::map<std::filesystem::path, std::unique_ptr<BuildState>> build_states{};
+    const auto build_dir = std::filesystem::weakly_canonical(build_directory);
+    const auto [build_dir_end, object_file_end] = std::ranges::mismatch(build_dir, object_file);
+    const auto state_file = (build_dir_end == build_dir.end() ? build_dir : object_file.parent_path()) / build_state_file;
+
+    auto& build_state = build_states[state_file];
+    if (not build_state)
+    {
+        build_state = std::make_unique<BuildState>(state_file);
+    }
+    return *build_state;
+}
+
+std::optional<CompileJob> find_recorded_compile_job(const std::filesystem::path& object_file)
+{
+    return get_build_state(object_file).find(object_file);
+}
+
+void record_compile_job(const CompileJob& compile_job)
+{
+    get_build_state(compile_job.object_file).record(compile_job);
+}
+
+FileStamp get_file_stamp(const std::filesystem::path& filename)
+{
+    struct stat file_stat{};
+    if (stat(filename.c_str(), &file_stat) != 0)
+    {
+        return FileStamp{};
+    }
+
+    return FileStamp{
+        .timestamp = static_cast<uint64_t>(file_stat.st_mtim.tv_sec) * 1'000'000'000 + static_cast<uint64_t>(file_stat.st_mtim.tv_nsec),
+        .size = static_cast<uint64_t>(file_stat.st_size),
+        .inode = static_cast<uint64_t>(file_stat.st_ino),
+    };
+}
+
+uint64_t hash_bytes(uint64_t hash, const std::string_view& bytes)
+{
+    constexpr uint64_t multiplier = 0x9E3779B97F4A7C15;
+    size_t position = 0;
+    for (; position + sizeof(uint64_t) <= bytes.size(); position += sizeof(uint64_t))
+    {
+        uint64_t word{};
+        std::memcpy(&word, bytes.data() + position, sizeof(word));
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 32;
+    }
+    for (; position < bytes.size(); ++position)
+    {
+        hash = (hash ^ static_cast<unsigned char>(bytes[position])) * 0x100000001B3;
+    }
+    return hash;
+}
+
+uint64_t hash_file_stamp(const std::filesystem::path& filename)
+{
+    const auto stamp = get_file_stamp(filename);
+    return hash_bytes(0, std::format("{} {} {}", stamp.timestamp, stamp.size, stamp.inode));
+}
+
+uint64_t hash_file_content(const std::filesystem::path& filename)
+{
+    std::ifstream file{filename, std::ios::binary};
+    if (not file)
+    {
+        return 0;
+    }
+
+    uint64_t hash = 0xCBF29CE484222325;
+    std::string buffer(64 * 1024, '\0');
+    while (file.read(buffer.data(), buffer.size()) or file.gcount() > 0)
+    {
+        hash = hash_bytes(hash, std::string_view{buffer.data(), static_cast<size_t>(file.gcount())});
+    }
+    return hash != 0 ? hash : 1;  // 0 is reserved for "not hashed"
+}
+
+std::vector<uint64_t> hash_files_in_parallel(const std::vector<std::filesystem::path>& files)
+{
+    std::vector<uint64_t> hashes(files.size());
+    for_each_in_parallel(files.size(), [&](size_t index)
+    {
+        hashes[index] = hash_file_content(files[index]);
+    });
+    return hashes;
+}
+
+enum class InputState { Unchanged, Changed, NeedsContentCheck };
+
+InputState check_file_stamp(const FileStamp& recorded, const FileStamp& current)
+{
+    if (have_same_stat(recorded, current))
+    {
+        return InputState::Unchanged;
+    }
+
+    // Only files with equal size can have equal content
+    if (content_hashing and recorded.content_hash != 0 and recorded.size == current.size)
+    {
+        return InputState::NeedsContentCheck;
+    }
+    return InputState::Changed;
+}
+
+// Parses make rules written by -MMD and returns prerequisites of rules for target, except the source itself,
+// which is first one. Other rules, like ones gcc writes for modules (.c++-module targets, CXX_IMPORTS +=), are skipped.
+std::vector<std::filesystem::path> read_depfile(const std::filesystem::path& depfile, const std::filesystem::path& target)
+{
+    std::ifstream file{depfile};
+    if (not file)
+    {
+        trace_error(std::format("Could not open dependency file {}", depfile.string()));
+        return {};
+    }
+
+    std::vector<std::vector<std::string>> rules{};
+    std::vector<std::string> entries{};
+    std::string entry{};
+    auto end_entry = [&]()
+    {
+        if (not entry.empty()) entries.push_back(std::move(entry));
+        entry.clear();
+    };
+    char character{};
+    while (file.get(character))
+    {
+        if (character == '\\' and file.peek() != EOF)
+        {
+            const char escaped = static_cast<char>(file.get());
+            if (escaped == '\n') continue;  // line continuation
+            if (escaped != ' ' and escaped != '#') entry.push_back(character);
+            entry.push_back(escaped);
+        }
+        else if (character == '$' and file.peek() == '$')
+        {
+            entry.push_back(static_cast<char>(file.get()));
+        }
+        else if (character == '\n')
+        {
+            end_entry();
+            if (not entries.empty()) rules.push_back(std::move(entries));
+            entries.clear();
+        }
+        else if (std::isspace(static_cast<unsigned char>(character)))
+        {
+            end_entry();
+        }
+        else
+        {
+            entry.push_back(character);
+        }
+    }
+    end_entry();
+    if (not entries.empty()) rules.push_back(std::move(entries));
+
+    std::vector<std::filesystem::path> headers{};
+    bool source_skipped = false;
+    for (const auto& rule : rules)
+    {
+        // Targets end with colon, possibly glued to it or to order-only prerequisites marker
+        bool is_target_rule = false;
+        bool in_prerequisites = false;
+        std::vector<std::string> prerequisites{};
+        for (const auto& token : rule)
+        {
+            if (in_prerequisites)
+            {
+                prerequisites.push_back(token);
+                continue;
+            }
+            const auto colon = token.find(':');
+            const auto name = token.substr(0, colon);
+            if (not name.empty() and std::filesystem::path{name} == target)
+            {
+                is_target_rule = true;
+            }
+            if (colon != std::string::npos)
+            {
+                in_prerequisites = true;
+                prerequisites.push_back(token.substr(colon + 1));
+            }
+        }
+        if (not is_target_rule) continue;
+
+        for (const auto& prerequisite : prerequisites)
+        {
+            if (prerequisite.empty() or prerequisite == "|" or prerequisite.ends_with(".c++-module")) continue;
+            if (not source_skipped)
+            {
+                source_skipped = true;
+                continue;
+            }
+            headers.emplace_back(prerequisite.starts_with('|') ? prerequisite.substr(1) : prerequisite);
+        }
+    }
+    return headers;
+}
+
+// Same clock kernel takes modification times from, so file modified after call never has older stamp
+uint64_t get_current_file_timestamp()
+{
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1'000'000'000 + static_cast<uint64_t>(now.tv_nsec);
+}
+
+// Headers modified since job started get zero stamp, so they count as changed in next build. Content hashes
+// are only taken over from previous record of job when stat matches, the rest is hashed by hash_compiled_inputs.
+void record_header_dependencies(CompileJob& compile_job, const std::vector<std::filesystem::path>& headers, const uint64_t start_timestamp)
+{
+    std::map<std::filesystem::path, FileStamp> recorded_stamps{};
+    if (const auto recorded_job = content_hashing ? find_recorded_compile_job(compile_job.object_file) : std::nullopt)
+    {
+        recorded_stamps[recorded_job->source_file] = recorded_job->source_stamp;
+        for (const auto& dependency : recorded_job->header_dependencies)
+        {
+            recorded_stamps[dependency.header_file] = dependency.header_stamp;
+        }
+    }
+    auto take_stamp = [&](const std::filesystem::path& file)
+    {
+        auto stamp = get_file_stamp(file);
+        if (stamp.timestamp >= start_timestamp)
+        {
+            return FileStamp{};
+        }
+        if (const auto recorded = recorded_stamps.find(file); recorded != recorded_stamps.end() and have_same_stat(recorded->second, stamp))
+        {
+            stamp.content_hash = recorded->second.content_hash;
+        }
+        return stamp;
+    };
+
+    compile_job.header_dependencies.clear();
+    for (const auto& header : headers)
+    {
+        if (header == compile_job.precompiled_header) continue;  // listed once, below
+        compile_job.header_dependencies.push_back(HeaderDependency{
+            .header_file = header,
+            .header_stamp = take_stamp(header),
+        });
+    }
+
+    if (not compile_job.precompiled_header.empty())
+    {
+        compile_job.header_dependencies.push_back(HeaderDependency{
+            .header_file = compile_job.precompiled_header,
+            .header_stamp = take_stamp(compile_job.precompiled_header),
+        });
+    }
+
+    // Source stamp was taken before compilation
+    if (const auto recorded = recorded_stamps.find(compile_job.source_file);
+        recorded != recorded_stamps.end() and have_same_stat(recorded->second, compile_job.source_stamp))
+    {
+        compile_job.source_stamp.content_hash = recorded->second.content_hash;
+    }
+}
+
+void collect_header_dependencies(CompileJob& compile_job, const uint64_t start_timestamp)
+{
+    const auto depfile = compile_job.object_file.string() + depfile_extension;
+    record_header_dependencies(compile_job, read_depfile(depfile, compile_job.object_file), start_timestamp);
+}
+
+// Hashes inputs of compiled jobs not hashed yet once build is done, each file only once and in parallel.
+// Hash is kept only when file was not modified since its stamp was taken, otherwise it would describe other content.
+void hash_compiled_inputs(std::vector<Job>& build_jobs)
+{
+    std::vector<CompileJob*> compiled_jobs{};
+    std::vector<std::filesystem::path> files_to_hash{};
+    auto needs_hash = [](const FileStamp& stamp) { return stamp.timestamp != 0 and stamp.content_hash == 0; };
+    for (auto& job : build_jobs)
+    {
+        auto* compile_job = std::get_if<CompileJob>(&job.specific_job);
+        if (not compile_job or job.status != Job::Status::Completed)
+        {
+            continue;
+        }
+        compiled_jobs.push_back(compile_job);
+        if (needs_hash(compile_job->source_stamp)) files_to_hash.push_back(compile_job->source_file);
+        for (const auto& dependency : compile_job->header_dependencies)
+        {
+            if (needs_hash(dependency.header_stamp)) files_to_hash.push_back(dependency.header_file);
+        }
+    }
+    std::ranges::sort(files_to_hash);
+    const auto duplicates = std::ranges::unique(files_to_hash);
+    files_to_hash.erase(duplicates.begin(), duplicates.end());
+    if (files_to_hash.empty())
+    {
+        return;
+    }
+
+    const auto hashes = hash_files_in_parallel(files_to_hash);
+    std::vector<FileStamp> stamps_after_hashing(files_to_hash.size());
+    std::ranges::transform(files_to_hash, stamps_after_hashing.begin(), get_file_stamp);
+    auto fill_hash = [&](const std::filesystem::path& file, FileStamp& stamp)
+    {
+        const auto found = std::ranges::lower_bound(files_to_hash, file);
+        const auto index = static_cast<size_t>(found - files_to_hash.begin());
+        if (found != files_to_hash.end() and *found == file and needs_hash(stamp) and have_same_stat(stamp, stamps_after_hashing[index]))
+        {
+            stamp.content_hash = hashes[index];
+            return true;
+        }
+        return false;
+    };
+
+    for (auto* compile_job : compiled_jobs)
+    {
+        bool hashed = fill_hash(compile_job->source_file, compile_job->source_stamp);
+        for (auto& dependency : compile_job->header_dependencies)
+        {
+            hashed = fill_hash(dependency.header_file, dependency.header_stamp) or hashed;
+        }
+        if (hashed)
+        {
+            record_compile_job(*compile_job);
+        }
+    }
+}
+
+InputState check_recorded_inputs(const CompileJob& recorded_job, const CompileJob& new_job)
+{
+    auto state = check_file_stamp(recorded_job.source_stamp, new_job.source_stamp);
+    for (const auto& dependency : recorded_job.header_dependencies)
+    {
+        if (state == InputState::Changed)
+        {
+            break;
+        }
+        const auto header_state = check_file_stamp(dependency.header_stamp, get_file_stamp(dependency.header_file));
+        if (header_state != InputState::Unchanged)
+        {
+            state = header_state;
+        }
+    }
+    return state;
+}
+
+// Compile job whose inputs differ from recorded ones only by stat data, content hashes decide if it is outdated
+struct ContentCheck
+{
+    CompileJob compile_job;
+    CompileJob recorded_job;
+};
+
+std::optional<ContentCheck> prepare_compile_job(Target& target, const CompileJob& new_compile_job, const bool force_compilation)
+{
+    if (not force_compilation)
+    {
+        auto recorded_compile_job = find_recorded_compile_job(new_compile_job.object_file);
+        if (recorded_compile_job and *recorded_compile_job == new_compile_job)
+        {
+            switch (check_recorded_inputs(*recorded_compile_job, new_compile_job))
+            {
+                case InputState::Unchanged:
+                    // TODO add verbosity level to print that file is up to date
+                    return std::nullopt;
+                case InputState::NeedsContentCheck:
+                    return ContentCheck{.compile_job = new_compile_job, .recorded_job = *recorded_compile_job};
+                case InputState::Changed:
+                    break;
+            }
+        }
+    }
+
+    target.needs_linking = true;
+    target.build_jobs.push_back(Job{new_compile_job});
+    return std::nullopt;
+}
+
+CompileJob create_compile_job(const std::string& flags, const bool use_build_dir, const std::filesystem::path& source, const std::filesystem::path& precompiled_header)
+{
+    create_directory_if_missing(build_directory);
+    auto canonical_build_dir = std::filesystem::canonical(build_directory);
+
+    std::filesystem::path relative_source_path{};
+    if (source.is_absolute())
+    {
+        relative_source_path = std::filesystem::relative(source, project_directory);
+    }
+    else
+    {
+        relative_source_path = source;
+    }
+
+    auto build_source_file = canonical_build_dir / relative_source_path;
+    auto build_source_path = build_source_file.parent_path();
+
+    if (use_build_dir)  
+    {
+        create_directory_if_missing(build_source_path);
+    }
+    else   
+    {
+        build_source_file = source;
+        build_source_path = ".";
+    }
+
+    auto object_file = std::filesystem::canonical(build_source_path);
+
+    object_file /= source.filename();
+    object_file = std::filesystem::path{object_file.string() + object_file_extension};
+
+    return CompileJob{
+        .source_file = relative_source_path,
+        .object_file = object_file,
+        .compile_flags = CompileFlags{flags},
+        .source_stamp = get_file_stamp(source),
+        .precompiled_header = precompiled_header,
+    };
+}
+
+std::optional<ContentCheck> prepare_file_compilation(Target& target, const std::string& flags, const bool use_build_dir, const std::filesystem::path& source,
+    const std::filesystem::path& precompiled_header, const bool force_compilation)
+{
+    const auto new_compile_job = create_compile_job(flags, use_build_dir, source, precompiled_header);
+    target.object_files.push_back(new_compile_job.object_file);
+    return prepare_compile_job(target, new_compile_job, force_compilation);
+}
+
+// Hashes all inputs with changed stat data at once, so that they can be processed in parallel.
+// Jobs with unchanged content get their stamps refreshed, so next build takes the stat only path again.
+void resolve_content_checks(Target& target, std::vector<ContentCheck>& content_checks)
+{
+    if (content_checks.empty())
+    {
+        return;
+    }
+
+    std::vector<std::filesystem::path> files_to_hash{};
+    for (const auto& check : content_checks)
+    {
+        files_to_hash.push_back(check.compile_job.source_file);
+        for (const auto& dependency : check.recorded_job.header_dependencies)
+        {
+            files_to_hash.push_back(dependency.header_file);
+        }
+    }
+    std::ranges::sort(files_to_hash);
+    const auto duplicates = std::ranges::unique(files_to_hash);
+    files_to_hash.erase(duplicates.begin(), duplicates.end());
+
+    const auto hashes = hash_files_in_parallel(files_to_hash);
+    auto content_hash_of = [&](const std::filesystem::path& file)
+    {
+        const auto found = std::ranges::lower_bound(files_to_hash, file);
+        return hashes[static_cast<size_t>(found - files_to_hash.begin())];
+    };
+
+    for (auto& check : content_checks)
+    {
+        auto& recorded_job = check.recorded_job;
+        bool content_unchanged = content_hash_of(check.compile_job.source_file) == recorded_job.source_stamp.content_hash;
+        for (const auto& dependency : recorded_job.header_dependencies)
+        {
+            content_unchanged = content_unchanged and content_hash_of(dependency.header_file) == dependency.header_stamp.content_hash;
+        }
+
+        if (not content_unchanged)
+        {
+            target.needs_linking = true;
+            target.build_jobs.push_back(Job{check.compile_job});
+            continue;
+        }
+
+        recorded_job.source_stamp = check.compile_job.source_stamp;
+        recorded_job.source_stamp.content_hash = content_hash_of(check.compile_job.source_file);
+        for (auto& dependency : recorded_job.header_dependencies)
+        {
+            dependency.header_stamp = get_file_stamp(dependency.header_file);
+            dependency.header_stamp.content_hash = content_hash_of(dependency.header_file);
+        }
+        record_compile_job(recorded_job);
+    }
+}
+
+std::string get_precompiled_header_extension()
+{
+    return is_clang_compiler() ? clang_precompiled_header_extension : gcc_precompiled_header_extension;
+}
+
+// Compiler picks up precompiled header placed next to the file given with -include.
+// That file is a stub including the real header, so it is also usable when precompiled header gets rejected.
+std::filesystem::path get_precompiled_header_stub(const Target& target, const bool use_build_dir)
+{
+    const auto canonical_build_dir = std::filesystem::canonical(use_build_dir ? build_directory : current_directory);
+    return canonical_build_dir / precompiled_headers_directory / target.name / target.precompiled_header.filename();
+}
+
+void write_precompiled_header_stub(const Target& target, const std::filesystem::path& stub)
+{
+    const auto stub_content = std::format("#include \"{}\"\n", std::filesystem::canonical(target.precompiled_header).string());
+
+    // Rewriting unchanged stub would bump its timestamp and force precompiled header rebuild
+    if (read_file_content(stub) == stub_content)
+    {
+        return;
+    }
+
+    create_directory_if_missing(stub.parent_path());
+    if (std::ofstream file{stub}; file)
+    {
+        std::print(file, "{}", stub_content);
+    }
+    else
+    {
+        trace_error(std::format("Could not write precompiled header stub {}", stub.string()));
+        exit(-1);
+    }
+}
+
+// Returns index of precompiled header job if it needs to be built
+std::optional<size_t> prepare_precompiled_header(Target& target, const std::string& flags, const std::filesystem::path& stub)
+{
+    write_precompiled_header_stub(target, stub);
+
+    const auto precompiled_header = std::filesystem::path{stub.string() + get_precompiled_header_extension()};
+    CompileJob precompiled_header_job{
+        .source_file = stub,
+        .object_file = precompiled_header,
+        .compile_flags = CompileFlags{flags},
+        .source_stamp = get_file_stamp(stub),
+        .produces_precompiled_header = true,
+    };
+
+    const auto job_index = target.build_jobs.size();
+    std::vector<ContentCheck> content_checks{};
+    if (auto content_check = prepare_compile_job(target, precompiled_header_job, false))
+    {
+        content_checks.push_back(std::move(*content_check));
+    }
+    resolve_content_checks(target, content_checks);
+
+    if (target.build_jobs.size() == job_index)
+    {
+        return std::nullopt;
+    }
+    return job_index;
+}
+
+struct ModuleDependencies
+{
+    std::vector<std::string> provided_modules{};
+    std::vector<std::string> required_modules{};
+};
+
+std::filesystem::path get_modules_directory(const Target& target, const bool use_build_dir)
+{
+    const auto canonical_build_dir = std::filesystem::canonical(use_build_dir ? build_directory : current_directory);
+    return canonical_build_dir / modules_directory / target.name;
+}
+
+// Module partitions "module:partition" are stored as "module-partition", which is also what clang expects in prebuilt module path
+std::filesystem::path get_module_interface_file(const std::filesystem::path& modules_dir, std::string module_name)
+{
+    std::ranges::replace(module_name, ':', '-');
+    return modules_dir / (module_name + (is_clang_compiler() ? clang_module_extension : gcc_module_extension));
+}
+
+std::string get_module_flags(const std::filesystem::path& modules_dir)
+{
+    if (is_clang_compiler())
+    {
+        return std::format("-fprebuilt-module-path={} ", modules_dir.string());
+    }
+    return std::format("-fmodules-ts -fmodule-mapper={} ", (modules_dir / gcc_module_mapper_file).string());
+}
+
+// Writes P1689 dependency file next to the object file
+bool scan_module_dependencies(const CompileJob& compile_job)
+{
+    const auto object_file = compile_job.object_file.string();
+    const auto dependencies_file = object_file + module_dependencies_extension;
+
+    std::vector<std::string> args{};
+    if (is_clang_compiler())
+    {
+        args = {clang_module_scanner, "-format=p1689", "--", compiler};
+        append_flags(args, compile_job.compile_flags);
+        args.insert(args.end(), {compile_flag, compile_output_flag, object_file});
+        append_source_language(args, compile_job.source_file);
+        args.push_back(compile_job.source_file.string());
+
+        auto [exit_code, output] = execute_command_with_output(args);
+        if (exit_code != 0)
+        {
+            std::print(stderr, "{}", output);
+            return false;
+        }
+        std::ofstream{dependencies_file} << output;
+        return true;
+    }
+
+    args = {compiler};
+    append_flags(args, compile_job.compile_flags);
+    args.insert(args.end(), {
+        preprocess_flag,
+        "-fdeps-format=p1689r5",
+        std::format("-fdeps-file={}", dependencies_file),
+        std::format("-fdeps-target={}", object_file),
+        "-MD", depfile_output_flag, dependencies_file + depfile_extension, "-MT", dependencies_file,
+        compile_output_flag, "/dev/null",
+    });
+    append_source_language(args, compile_job.source_file);
+    args.push_back(compile_job.source_file.string());
+
+    auto [exit_code, output] = execute_command_with_output(args);
+    if (exit_code != 0)
+    {
+        std::print(stderr, "{}", output);
+        return false;
+    }
+    return true;
+}
+
+ModuleDependencies read_module_dependencies(const std::filesystem::path& dependencies_file)
+{
+    const auto document = JsonParser{read_file_content(dependencies_file)}.parse();
+    const auto* rules = document ? document->find("rules") : nullptr;
+    if (rules == nullptr or rules->as_array() == nullptr)
+    {
+        trace_error(std::format("Malformed module dependencies file {}", dependencies_file.string()));
+        exit(1);
+    }
+
+    ModuleDependencies dependencies{};
+    for (const auto& rule : *rules->as_array())
+    {
+        for (const auto& [field, names] : {std::pair{"provides", &dependencies.provided_modules}, std::pair{"requires", &dependencies.required_modules}})
+        {
+            const auto* entries = rule.find(field);
+            if (entries == nullptr or entries->as_array() == nullptr) continue;
+
+            for (const auto& entry : *entries->as_array())
+            {
+                // Header units are not built by nobs, those are left for the compiler to resolve
+                const auto* lookup_method = entry.find("lookup-method");
+                if (lookup_method and lookup_method->as_string() and *lookup_method->as_string() != "by-name") continue;
+
+                if (const auto* logical_name = entry.find("logical-name"); logical_name and logical_name->as_string())
+                {
+                    names->push_back(*logical_name->as_string());
+                }
+            }
+        }
+    }
+    return dependencies;
+}
+
+void write_module_mapper(const std::filesystem::path& modules_dir, const std::map<std::string, size_t>& providers)
+{
+    std::string mapper_content{};
+    for (const auto& [module_name, source_index] : providers)
+    {
+        mapper_content.append(std::format("{} {}\n", module_name, get_module_interface_file(modules_dir, module_name).string()));
+    }
+
+    const auto mapper_file = modules_dir / gcc_module_mapper_file;
+    if (read_file_content(mapper_file) != mapper_content)
+    {
+        std::ofstream{mapper_file} << mapper_content;
+    }
+}
+
+// Scans module dependencies of target sources, schedules consumers of rebuilt modules
+// and orders module interface compilation before its importers
+void prepare_target_modules(Target& target, const std::string& flags, const bool use_build_dir,
+    const std::filesystem::path& precompiled_header, const size_t first_source_job)
+{
+    const auto modules_dir = get_modules_directory(target, use_build_dir);
+    const auto sources_count = target.sources.size();
+
+    std::map<std::filesystem::path, size_t> jobs_by_object_file{};
+    for (size_t job_index = first_source_job; job_index < target.build_jobs.size(); ++job_index)
+    {
+        jobs_by_object_file[std::get<CompileJob>(target.build_jobs[job_index].specific_job).object_file] = job_index;
+    }
+
+    std::vector<CompileJob> compile_jobs{};
+    std::vector<std::optional<size_t>> scheduled_jobs(sources_count);
+    for (size_t source_index = 0; source_index < sources_count; ++source_index)
+    {
+        compile_jobs.push_back(create_compile_job(flags, use_build_dir, target.sources[source_index], precompiled_header));
+        if (const auto job = jobs_by_object_file.find(compile_jobs.back().object_file); job != jobs_by_object_file.end())
+        {
+            scheduled_jobs[source_index] = job->second;
+        }
+    }
+
+    // Unchanged sources reuse their previous scan results
+    std::vector<size_t> sources_to_scan{};
+    for (size_t source_index = 0; source_index < sources_count; ++source_index)
+    {
+        const auto dependencies_file = compile_jobs[source_index].object_file.string() + module_dependencies_extension;
+        if (scheduled_jobs[source_index] or not std::filesystem::exists(dependencies_file))
+        {
+            sources_to_scan.push_back(source_index);
+        }
+    }
+
+    std::atomic<bool> scan_failed{false};
+    for_each_in_parallel(sources_to_scan.size(), [&](size_t index)
+    {
+        if (not scan_module_dependencies(compile_jobs[sources_to_scan[index]]))
+        {
+            trace_error(std::format("Module dependency scan of {} failed", compile_jobs[sources_to_scan[index]].source_file.string()));
+            scan_failed = true;
+        }
+    });
+    if (scan_failed)
+    {
+        exit(1);
+    }
+
+    std::vector<ModuleDependencies> module_dependencies{};
+    std::map<std::string, size_t> providers{};
+    for (size_t source_index = 0; source_index < sources_count; ++source_index)
+    {
+        module_dependencies.push_back(read_module_dependencies(compile_jobs[source_index].object_file.string() + module_dependencies_extension));
+        for (const auto& module_name : module_dependencies.back().provided_modules)
+        {
+            if (auto [provider, inserted] = providers.try_emplace(module_name, source_index); not inserted)
+            {
+                trace_error(std::format("Module {} is provided by both {} and {}", module_name,
+                    target.sources[provider->second].string(), target.sources[source_index].string()));
+                exit(1);
+            }
+        }
+    }
+
+    // Import cycles would make scheduler wait forever
+    enum class Visit { None, InProgress, Done };
+    std::vector<Visit> visits(sources_count, Visit::None);
+    std::function<void(size_t)> check_cycles = [&](size_t source_index)
+    {
+        visits[source_index] = Visit::InProgress;
+        for (const auto& module_name : module_dependencies[source_index].required_modules)
+        {
+            const auto provider = providers.find(module_name);
+            if (provider == providers.end() or provider->second == source_index) continue;
+            if (visits[provider->second] == Visit::InProgress)
+            {
+                trace_error(std::format("Module import cycle detected at {} importing {}", target.sources[source_index].string(), module_name));
+                exit(1);
+            }
+            if (visits[provider->second] == Visit::None) check_cycles(provider->second);
+        }
+        visits[source_index] = Visit::Done;
+    };
+    for (size_t source_index = 0; source_index < sources_count; ++source_index)
+    {
+        if (visits[source_index] == Visit::None) check_cycles(source_index);
+    }
+
+    auto schedule = [&](size_t source_index)
+    {
+        scheduled_jobs[source_index] = target.build_jobs.size();
+        target.needs_linking = true;
+        target.build_jobs.push_back(Job{compile_jobs[source_index]});
+    };
+
+    for (const auto& [module_name, source_index] : providers)
+    {
+        if (not scheduled_jobs[source_index] and not std::filesystem::exists(get_module_interface_file(modules_dir, module_name)))
+        {
+            schedule(source_index);
+        }
+    }
+
+    // Importers of rebuilt module interfaces are outdated as well
+    for (bool changed = true; changed; )
+    {
+        changed = false;
+        for (size_t source_index = 0; source_index < sources_count; ++source_index)
+        {
+            if (scheduled_jobs[source_index]) continue;
+            for (const auto& module_name : module_dependencies[source_index].required_modules)
+            {
+                const auto provider = providers.find(module_name);
+                if (provider != providers.end() and scheduled_jobs[provider->second])
+                {
+                    schedule(source_index);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (size_t source_index = 0; source_index < sources_count; ++source_index)
+    {
+        if (not scheduled_jobs[source_index]) continue;
+
+        auto& job = target.build_jobs[*scheduled_jobs[source_index]];
+        auto& compile_job = std::get<CompileJob>(job.specific_job);
+        compile_job.uses_modules = true;
+        if (not module_dependencies[source_index].provided_modules.empty())
+        {
+            compile_job.module_output = get_module_interface_file(modules_dir, module_dependencies[source_index].provided_modules.front());
+        }
+
+        for (const auto& module_name : module_dependencies[source_index].required_modules)
+        {
+            const auto provider = providers.find(module_name);
+            if (provider != providers.end() and provider->second != source_index and scheduled_jobs[provider->second])
+            {
+                job.depends_on.push_back(*scheduled_jobs[provider->second]);
+            }
+        }
+    }
+
+    if (not is_clang_compiler())
+    {
+        write_module_mapper(modules_dir, providers);
+    }
+}
+
+// Persistent unity build state of a target
+struct UnityState
+{
+    std::map<std::filesystem::path, uint64_t> compile_milliseconds{};  // per source, apportioned from batch compile times
+    std::map<std::filesystem::path, bool> suspects{};  // members of failed batch compiled separately, true when compiled fine alone
+    std::set<std::filesystem::path> excluded{};  // sources that compile alone, but not together with others
+    std::vector<std::vector<std::filesystem::path>> batches{};
+};
+
+// Generated unity sources and compilation results, looked up by run_build when job finishes
+struct UnityJob
+{
+    std::filesystem::path state_file;
+    std::vector<std::filesystem::path> sources;
+    bool is_batch;
+};
+
+static std::map<std::filesystem::path, UnityJob> unity_jobs{};  // indexed by object file
+
+std::filesystem::path get_unity_directory(const Target& target, const bool use_build_dir)
+{
+    const auto canonical_build_dir = std::filesystem::canonical(use_build_dir ? build_directory : current_directory);
+    return canonical_build_dir / unity_directory / target.name;
+}
+
+UnityState read_unity_state(const std::filesystem::path& state_file)
+{
+    UnityState state{};
+    std::ifstream file{state_file};
+    std::string line{};
+    while (std::getline(file, line))
+    {
+        std::istringstream entry{line};
+        std::string kind{};
+        entry >> kind;
+        if (kind == "batch")
+        {
+            state.batches.emplace_back();
+            continue;
+        }
+
+        uint64_t value{};
+        if (kind == "time" or kind == "suspect")
+        {
+            entry >> value;
+        }
+        std::string source{};
+        std::getline(entry >> std::ws, source);
+
+        if (kind == "time") state.compile_milliseconds[source] = value;
+        else if (kind == "suspect") state.suspects[source] = value != 0;
+        else if (kind == "excluded") state.excluded.insert(source);
+        else if (kind == "source" and not state.batches.empty()) state.batches.back().push_back(source);
+    }
+    return state;
+}
+
+void write_unity_state(const std::filesystem::path& state_file, const UnityState& state)
+{
+    std::ofstream file{state_file};
+    if (not file)
+    {
+        trace_error(std::format("Could not write unity build state {}", state_file.string()));
+        return;
+    }
+
+    for (const auto& [source, milliseconds] : state.compile_milliseconds)
+    {
+        std::println(file, "time {} {}", milliseconds, source.string());
+    }
+    for (const auto& [source, compiled_alone] : state.suspects)
+    {
+        std::println(file, "suspect {} {}", compiled_alone ? 1 : 0, source.string());
+    }
+    for (const auto& source : state.excluded)
+    {
+        std::println(file, "excluded {}", source.string());
+    }
+    for (const auto& batch : state.batches)
+    {
+        std::println(file, "batch");
+        for (const auto& source : batch)
+        {
+            std::println(file, "source {}", source.string());
+        }
+    }
+}
+
+size_t count_lines(const std::filesystem::path& source)
+{
+    const auto content = read_file_content(source);
+    return static_cast<size_t>(std::ranges::count(content, '\n')) + 1;
+}
+
+// Greedily packs sources in their order into batches of estimated compile time.
+// Sources without recorded time are estimated from their line count.
+std::vector<std::vector<std::filesystem::path>> plan_unity_batches(const std::vector<std::filesystem::path>& sources,
+    const UnityState& state, uint64_t batch_milliseconds)
+{
+    uint64_t recorded_milliseconds{};
+    size_t recorded_lines{};
+    std::vector<size_t> lines{};
+    for (const auto& source : sources)
+    {
+        lines.push_back(count_lines(source));
+        if (const auto recorded = state.compile_milliseconds.find(source); recorded != state.compile_milliseconds.end())
+        {
+            recorded_milliseconds += recorded->second;
+            recorded_lines += lines.back();
+        }
+    }
+    const double milliseconds_per_line = recorded_lines > 0 ? static_cast<double>(recorded_milliseconds) / recorded_lines : default_milliseconds_per_line;
+
+    std::vector<uint64_t> costs{};
+    uint64_t total_cost{};
+    for (size_t index = 0; index < sources.size(); ++index)
+    {
+        const auto recorded = state.compile_milliseconds.find(sources[index]);
+        costs.push_back(recorded != state.compile_milliseconds.end() ? recorded->second
+            : static_cast<uint64_t>(static_cast<double>(lines[index]) * milliseconds_per_line));
+        total_cost += costs.back();
+    }
+
+    // Keep enough batches to occupy all parallel jobs
+    const auto batch_budget = std::max<uint64_t>(1, std::min(batch_milliseconds, total_cost / std::max<size_t>(parallel_jobs, 1)));
+
+    std::vector<std::vector<std::filesystem::path>> batches{};
+    uint64_t batch_cost{};
+    for (size_t index = 0; index < sources.size(); ++index)
+    {
+        if (batches.empty() or (batch_cost + costs[index] > batch_budget and not batches.back().empty()))
+        {
+            batches.emplace_back();
+            batch_cost = 0;
+        }
+        batches.back().push_back(sources[index]);
+        batch_cost += costs[index];
+    }
+    return batches;
+}
+
+void write_unity_source(const std::filesystem::path& unity_source, const std::vector<std::filesystem::path>& batch)
+{
+    std::string content{};
+    for (const auto& source : batch)
+    {
+        content.append(std::format("#include \"{}\"\n", std::filesystem::canonical(source).string()));
+    }
+
+    // Rewriting unchanged unity source would force its recompilation
+    if (read_file_content(unity_source) != content)
+    {
+        std::ofstream{unity_source} << content;
+    }
+}
+
+// Prepares compilation of unity batches, returns sources which have to be compiled separately
+std::vector<std::filesystem::path> prepare_target_unity_batches(Target& target, const std::string& flags, const bool use_build_dir,
+    const std::filesystem::path& precompiled_header, const bool force_compilation, std::vector<ContentCheck>& content_checks)
+{
+    const auto unity_dir = get_unity_directory(target, use_build_dir);
+    create_directory_if_missing(unity_dir);
+    const auto state_file = unity_dir / unity_state_file;
+    auto state = read_unity_state(state_file);
+
+    std::vector<std::filesystem::path> separate_sources{};
+    std::vector<std::filesystem::path> batched_sources{};
+    for (const auto& source : target.sources)
+    {
+        const bool compiled_separately = state.excluded.contains(source) or state.suspects.contains(source);
+        (compiled_separately ? separate_sources : batched_sources).push_back(source);
+    }
+
+    // Batches are planned again only when set of batched sources changes, so that their objects stay valid
+    std::vector<std::filesystem::path> planned_sources{};
+    for (const auto& batch : state.batches)
+    {
+        planned_sources.insert(planned_sources.end(), batch.begin(), batch.end());
+    }
+    auto current_sources = batched_sources;
+    std::ranges::sort(planned_sources);
+    std::ranges::sort(current_sources);
+    if (planned_sources != current_sources)
+    {
+        state.batches = plan_unity_batches(batched_sources, state, target.unity_batch_milliseconds);
+        write_unity_state(state_file, state);
+    }
+
+    for (size_t batch_index = 0; batch_index < state.batches.size(); ++batch_index)
+    {
+        const auto unity_source = unity_dir / std::format("{}_unity_{}.cpp", target.name, batch_index);
+        write_unity_source(unity_source, state.batches[batch_index]);
+
+        CompileJob batch_job{
+            .source_file = unity_source,
+            .object_file = unity_source.string() + object_file_extension,
+            .compile_flags = CompileFlags{flags},
+            .source_stamp = get_file_stamp(unity_source),
+            .precompiled_header = precompiled_header,
+        };
+        target.object_files.push_back(batch_job.object_file);
+        unity_jobs[batch_job.object_file] = UnityJob{.state_file = state_file, .sources = state.batches[batch_index], .is_batch = true};
+
+        if (auto content_check = prepare_compile_job(target, batch_job, force_compilation))
+        {
+            content_checks.push_back(std::move(*content_check));
+        }
+    }
+
+    for (const auto& source : state.suspects | std::views::keys)
+    {
+        auto compile_job = create_compile_job(flags, use_build_dir, source, precompiled_header);
+        unity_jobs[compile_job.object_file] = UnityJob{.state_file = state_file, .sources = {source}, .is_batch = false};
+    }
+    return separate_sources;
+}
+
+// Batch failing to compile makes its members suspects, compiled separately in next builds.
+// When all suspects compile fine alone, batch failure came from combining them and they stay excluded from batches.
+// When any of them fails alone too, it was a regular error and suspects go back to batches.
+void record_unity_job_result(const std::filesystem::path& object_file, const bool succeeded, const uint64_t milliseconds)
+{
+    const auto unity_job = unity_jobs.find(object_file);
+    if (unity_job == unity_jobs.end())
+    {
+        return;
+    }
+
+    auto state = read_unity_state(unity_job->second.state_file);
+    const auto& sources = unity_job->second.sources;
+    if (unity_job->second.is_batch and succeeded)
+    {
+        size_t total_lines{};
+        std::vector<size_t> lines{};
+        for (const auto& source : sources)
+        {
+            lines.push_back(count_lines(source));
+            total_lines += lines.back();
+        }
+        for (size_t index = 0; index < sources.size(); ++index)
+        {
+            state.compile_milliseconds[sources[index]] = milliseconds * lines[index] / std::max<size_t>(total_lines, 1);
+        }
+    }
+    else if (unity_job->second.is_batch)
+    {
+        for (const auto& source : sources)
+        {
+            state.suspects[source] = false;
+        }
+    }
+    else if (succeeded)
+    {
+        state.suspects[sources.front()] = true;
+        if (std::ranges::all_of(state.suspects | std::views::values, std::identity{}))
+        {
+            for (const auto& source : state.suspects | std::views::keys)
+            {
+                std::println("{}Source {} does not compile in unity batch, it will be compiled separately.{}", YELLOW_FONT, source.string(), RESET_FONT);
+                state.excluded.insert(source);
+            }
+            state.suspects.clear();
+        }
+    }
+    else
+    {
+        state.suspects.clear();
+    }
+    write_unity_state(unity_job->second.state_file, state);
+}
+
+// Suspect with up to date object compiled fine alone in one of previous builds, it is not compiled again to tell that
+void resolve_up_to_date_unity_suspects(const Target& target, const bool use_build_dir, const size_t first_source_job)
+{
+    std::set<std::filesystem::path> scheduled_objects{};
+    for (size_t index = first_source_job; index < target.build_jobs.size(); ++index)
+    {
+        scheduled_objects.insert(std::get<CompileJob>(target.build_jobs[index].specific_job).object_file);
+    }
+
+    const auto state_file = get_unity_directory(target, use_build_dir) / unity_state_file;
+    for (const auto& [object_file, unity_job] : unity_jobs)
+    {
+        if (not unity_job.is_batch and unity_job.state_file == state_file and not scheduled_objects.contains(object_file))
+        {
+            record_unity_job_result(object_file, true, 0);
+        }
+    }
+}
+
+void prepare_target_compilation(Target& target, const bool use_build_dir = true)
+{
+    TraceScope trace_scope{"prepare_target_compilation", target.name};
+    create_directory_if_missing(build_directory);
+    target.object_files.clear();
+    
+    std::string flags{};
+    for (const auto & flag : target.compile_flags)
+    {  
+        flags.append(std::format("{} ", flag));
+    }
+
+    std::string source_flags{flags};
+    std::filesystem::path precompiled_header{};
+    std::optional<size_t> precompiled_header_job{};
+    if (not target.precompiled_header.empty())
+    {
+        const auto stub = get_precompiled_header_stub(target, use_build_dir);
+        precompiled_header_job = prepare_precompiled_header(target, flags, stub);
+        precompiled_header = stub.string() + get_precompiled_header_extension();
+        source_flags.append(std::format("{} {} ", include_flag, stub.string()));
+    }
+
+    if (target.uses_modules)
+    {
+        create_directory_if_missing(get_modules_directory(target, use_build_dir));
+        source_flags.append(get_module_flags(get_modules_directory(target, use_build_dir)));
+    }
+
+    // Every translation unit compiled with old precompiled header is outdated
+    const bool force_compilation = precompiled_header_job.has_value();
+    const auto first_source_job = target.build_jobs.size();
+
+    std::vector<ContentCheck> content_checks{};
+    auto separate_sources = target.sources;
+    const bool uses_unity_build = target.unity_batch_milliseconds > 0 and unity_builds_enabled and not target.uses_modules;
+    if (uses_unity_build)
+    {
+        separate_sources = prepare_target_unity_batches(target, source_flags, use_build_dir, precompiled_header, force_compilation, content_checks);
+    }
+
+    for (const auto& source : separate_sources)
+    {    
+        if (auto content_check = prepare_file_compilation(target, source_flags, use_build_dir, source, precompiled_header, force_compilation))
+        {
+            content_checks.push_back(std::move(*content_check));
+        }
+    }
+    resolve_content_checks(target, content_checks);
+
+    if (uses_unity_build)
+    {
+        resolve_up_to_date_unity_suspects(target, use_build_dir, first_source_job);
+    }
+
+    if (target.uses_modules)
+    {
+        prepare_target_modules(target, source_flags, use_build_dir, precompiled_header, first_source_job);
+    }
+
+    if (precompiled_header_job)
+    {
+        for (size_t index = first_source_job; index < target.build_jobs.size(); ++index)
+        {
+            target.build_jobs[index].depends_on.push_back(*precompiled_header_job);
+        }
+    }
+
+    for (auto& job : target.build_jobs)
+    {
+        job.pool = target.pool;
+        job.environment = target.environment;
+        job.working_directory = target.working_directory;
+    }
+}
+
+struct IncludedHeader
+{
+    std::filesystem::path header_file;
+    size_t depth;
+};
+
+// Parses include tree printed by -H, where every header is prefixed with dots showing its nesting depth
+std::vector<IncludedHeader> parse_include_tree(const std::string& compiler_output)
+{
+    std::vector<IncludedHeader> headers{};
+    std::istringstream lines{compiler_output};
+    std::string line{};
+    while (std::getline(lines, line))
+    {
+        const auto depth = line.find_first_not_of('.');
+        if (depth == 0 or depth == std::string::npos or line[depth] != ' ')
+        {
+            continue;  // precompiled header markers, include guard hints, diagnostics
+        }
+        headers.push_back(IncludedHeader{.header_file = line.substr(depth + 1), .depth = depth});
+    }
+    return headers;
+}
+
+std::vector<std::string> build_include_tree_command_args(const CompileFlags& flags, const std::filesystem::path& source)
+{
+    std::vector<std::string> args{compiler};
+    append_flags(args, flags);
+    args.push_back(preprocess_flag);
+    args.push_back(include_tree_flag);
+    args.push_back(compile_output_flag);
+    args.push_back("/dev/null");
+    append_source_language(args, source);
+    args.push_back(source.string());
+    return args;
+}
+
+struct PrecompiledHeaderCandidate
+{
+    std::filesystem::path header_file;
+    size_t translation_units{};
+    uint64_t included_bytes{};  // summed over all translation units, including nested headers
+};
+
+// Headers included directly by translation units are ranked by how many bytes they bring in across whole target
+std::vector<PrecompiledHeaderCandidate> find_precompiled_header_candidates(const Target& target)
+{
+    std::string flags_text{};
+    for (const auto & flag : target.compile_flags)
+    {
+        flags_text.append(std::format("{} ", flag));
+    }
+    const CompileFlags flags{flags_text};  // interned before workers start, interned table is not thread safe
+
+    std::vector<std::string> outputs(target.sources.size());
+    for_each_in_parallel(target.sources.size(), [&](size_t index)
+    {
+        auto [exit_code, output] = execute_command_with_output(build_include_tree_command_args(flags, target.sources[index]));
+        if (exit_code != 0)
+        {
+            trace_error(std::format("Could not preprocess {}", target.sources[index].string()));
+        }
+        outputs[index] = std::move(output);
+    });
+
+    std::map<std::filesystem::path, uint64_t> header_sizes{};
+    auto header_size = [&](const std::filesystem::path& header)
+    {
+        auto [entry, inserted] = header_sizes.try_emplace(header, 0);
+        if (inserted) entry->second = get_file_stamp(header).size;
+        return entry->second;
+    };
+
+    std::map<std::filesystem::path, PrecompiledHeaderCandidate> candidates{};
+    for (const auto& output : outputs)
+    {
+        const auto headers = parse_include_tree(output);
+        for (size_t index = 0; index < headers.size(); ++index)
+        {
+            if (headers[index].depth != 1)
+            {
+                continue;
+            }
+
+            auto& candidate = candidates[headers[index].header_file];
+            candidate.header_file = headers[index].header_file;
+            candidate.translation_units++;
+            candidate.included_bytes += header_size(headers[index].header_file);
+            for (size_t nested = index + 1; nested < headers.size() and headers[nested].depth > 1; ++nested)
+            {
+                candidate.included_bytes += header_size(headers[nested].header_file);
+            }
+        }
+    }
+
+    std::vector<PrecompiledHeaderCandidate> ranked_candidates{};
+    for (auto& [header_file, candidate] : candidates)
+    {
+        // Header used by a single translation unit gains nothing from being precompiled
+        if (candidate.translation_units > 1 or target.sources.size() == 1)
+        {
+            ranked_candidates.push_back(std::move(candidate));
+        }
+    }
+    std::ranges::sort(ranked_candidates, std::ranges::greater{}, &PrecompiledHeaderCandidate::included_bytes);
+    return ranked_candidates;
+}
+
+// Include trees are read for all object files of target, also the ones not recompiled in this build
+void analyze_target_includes(Target& target)
+{
+    std::map<std::filesystem::path, uint64_t> header_sizes{};
+    auto header_size = [&](const std::filesystem::path& header)
+    {
+        auto [entry, inserted] = header_sizes.try_emplace(header, 0);
+        if (inserted) entry->second = get_file_stamp(header).size;
+        return entry->second;
+    };
+
+    std::map<std::filesystem::path, HeaderCost> costs{};
+    for (const auto& object_file : target.object_files)
+    {
+        const auto headers = parse_include_tree(read_file_content(object_file.string() + include_tree_extension));
+        std::set<std::filesystem::path> translation_unit_headers{};
+        for (size_t index = 0; index < headers.size(); ++index)
+        {
+            auto& cost = costs[headers[index].header_file];
+            cost.header_file = headers[index].header_file;
+            cost.inclusions++;
+            cost.included_bytes += header_size(headers[index].header_file);
+            for (size_t nested = index + 1; nested < headers.size() and headers[nested].depth > headers[index].depth; ++nested)
+            {
+                cost.included_bytes += header_size(headers[nested].header_file);
+            }
+            if (translation_unit_headers.insert(headers[index].header_file).second)
+            {
+                cost.translation_units++;
+            }
+        }
+    }
+
+    target.header_costs.clear();
+    for (auto& [header_file, cost] : costs)
+    {
+        target.header_costs.push_back(std::move(cost));
+    }
+    std::ranges::sort(target.header_costs, std::ranges::greater{}, &HeaderCost::included_bytes);
+}
+
+void print_header_costs(const Target& target)
+{
+    constexpr size_t max_headers = 20;
+    if (target.header_costs.empty())
+    {
+        std::println("{}No include trees recorded for target {}{}{}, rebuild it with include report enabled.{}", YELLOW_FONT, RED_FONT, target.name, YELLOW_FONT, RESET_FONT);
+        return;
+    }
+
+    std::println("{}Most expensive headers of target {}{}{}:{}", YELLOW_FONT, RED_FONT, target.name, YELLOW_FONT, RESET_FONT);
+    std::println("{:>10} {:>12} {:>6}  {}", "inclusions", "KiB parsed", "TUs", "header");
+    for (const auto& cost : target.header_costs | std::views::take(max_headers))
+    {
+        std::println("{:>10} {:>12} {:>6}  {}", cost.inclusions, cost.included_bytes / 1024, cost.translation_units, cost.header_file.string());
+    }
+}
+
+void print_precompiled_header_candidates(const Target& target)
+{
+    constexpr size_t max_candidates = 10;
+    const auto candidates = find_precompiled_header_candidates(target);
+    if (candidates.empty())
+    {
+        std::println("{}No precompiled header candidates for target {}{}{}.{}", YELLOW_FONT, RED_FONT, target.name, YELLOW_FONT, RESET_FONT);
+        return;
+    }
+
+    std::println("{}Precompiled header candidates for target {}{}{}:{}", YELLOW_FONT, RED_FONT, target.name, YELLOW_FONT, RESET_FONT);
+    std::println("{:>6} {:>12}  {}", "TUs", "KiB parsed", "header");
+    for (const auto& candidate : candidates | std::views::take(max_candidates))
+    {
+        std::println("{:>6} {:>12}  {}", candidate.translation_units, candidate.included_bytes / 1024, candidate.header_file.string());
+    }
+}
+
+std::filesystem::path default_cache_directory()
+{
+    if (const char* nobs_cache_dir = std::getenv("NOBS_CACHE_DIR"))
+    {
+        return nobs_cache_dir;
+    }
+    if (const char* xdg_cache_home = std::getenv("XDG_CACHE_HOME"))
+    {
+        return std::filesystem::path{xdg_cache_home} / "nobs";
+    }
+    if (const char* home = std::getenv("HOME"))
+    {
+        return std::filesystem::path{home} / ".cache" / "nobs";
+    }
+    return std::filesystem::temp_directory_path() / "nobs_cache";
+}
+
+// Identifies compiler binary by its resolved location, size and modification time
+uint64_t compiler_fingerprint()
+{
+    static const uint64_t fingerprint = []()
+    {
+        std::filesystem::path compiler_path{compiler};
+        if (compiler.find('/') == std::string::npos)
+        {
+            std::istringstream path_entries{std::getenv("PATH") ? std::getenv("PATH") : ""};
+            std::string entry{};
+            while (std::getline(path_entries, entry, ':'))
+            {
+                if (access((std::filesystem::path{entry} / compiler).c_str(), X_OK) == 0)
+                {
+                    compiler_path = std::filesystem::path{entry} / compiler;
+                    break;
+                }
+            }
+        }
+
+        std::error_code error{};
+        const auto resolved_path = std::filesystem::canonical(compiler_path, error);
+        const auto stamp = get_file_stamp(resolved_path);
+        return hash_bytes(0, std::format("{}\n{}\n{}", error ? compiler : resolved_path.string(), stamp.size, stamp.timestamp));
+    }();
+    return fingerprint;
+}
+
+// SHA-256, compilation cache is shared between builds, so its keys have to be collision resistant
+class Sha256
+{
+public:
+    void update(const std::string_view& bytes)
+    {
+        for (const char byte : bytes)
+        {
+            block_[block_size_++] = static_cast<uint8_t>(byte);
+            if (block_size_ == block_.size())
+            {
+                process_block();
+                block_size_ = 0;
+            }
+        }
+        length_ += bytes.size();
+    }
+
+    // Lowercase hex digest, hasher can't be updated afterwards
+    std::string finish()
+    {
+        const uint64_t bit_length = length_ * 8;
+        block_[block_size_++] = 0x80;
+        if (block_size_ > 56)
+        {
+            std::fill(block_.begin() + block_size_, block_.end(), 0);
+            process_block();
+            block_size_ = 0;
+        }
+        std::fill(block_.begin() + block_size_, block_.begin() + 56, 0);
+        for (size_t i = 0; i < 8; ++i)
+        {
+            block_[56 + i] = static_cast<uint8_t>(bit_length >> (56 - 8 * i));
+        }
+        process_block();
+
+        std::string digest{};
+        for (const auto word : state_)
+        {
+            digest.append(std::format("{:08x}", word));
+        }
+        return digest;
+    }
+
+private:
+    static uint32_t rotate_right(uint32_t value, int bits)
+    {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    void process_block()
+    {
+        static constexpr std::array<uint32_t, 64> round_constants{
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+        };
+
+        std::array<uint32_t, 64> schedule{};
+        for (size_t i = 0; i < 16; ++i)
+        {
+            schedule[i] = static_cast<uint32_t>(block_[4 * i]) << 24 | static_cast<uint32_t>(block_[4 * i + 1]) << 16 |
+                static_cast<uint32_t>(block_[4 * i + 2]) << 8 | static_cast<uint32_t>(block_[4 * i + 3]);
+        }
+        for (size_t i = 16; i < 64; ++i)
+        {
+            const auto s0 = rotate_right(schedule[i - 15], 7) ^ rotate_right(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+            const auto s1 = rotate_right(schedule[i - 2], 17) ^ rotate_right(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+            schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+        }
+
+        auto [a, b, c, d, e, f, g, h] = state_;
+        for (size_t i = 0; i < 64; ++i)
+        {
+            const auto s1 = rotate_right(e, 6) ^ rotate_right(e, 11) ^ rotate_right(e, 25);
+            const auto choice = (e & f) ^ (~e & g);
+            const auto temporary1 = h + s1 + choice + round_constants[i] + schedule[i];
+            const auto s0 = rotate_right(a, 2) ^ rotate_right(a, 13) ^ rotate_right(a, 22);
+            const auto majority = (a & b) ^ (a & c) ^ (b & c);
+            const auto temporary2 = s0 + majority;
+            h = g;
+            g = f;
+            f = e;
+            e = d + temporary1;
+            d = c;
+            c = b;
+            b = a;
+            a = temporary1 + temporary2;
+        }
+        for (size_t i = 0; const auto value : {a, b, c, d, e, f, g, h})
+        {
+            state_[i++] += value;
+        }
+    }
+
+    std::array<uint32_t, 8> state_{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    std::array<uint8_t, 64> block_{};
+    size_t block_size_{};
+    uint64_t length_{};
+};
+
+// Empty when file can't be read
+std::string sha256_file_content(const std::filesystem::path& filename)
+{
+    std::ifstream file{filename, std::ios::binary};
+    if (not file)
+    {
+        return {};
+    }
+
+    Sha256 hasher{};
+    std::string buffer(64 * 1024, '\0');
+    while (file.read(buffer.data(), buffer.size()) or file.gcount() > 0)
+    {
+        hasher.update(std::string_view{buffer.data(), static_cast<size_t>(file.gcount())});
+    }
+    return hasher.finish();
+}
+
+bool has_debug_info_flag(const std::string& compile_flags)
+{
+    return compile_flags.starts_with("-g") or compile_flags.find(" -g") != std::string::npos;
+}
+
+// Direct mode key covers everything known before compilation. Headers are covered by the manifest stored under it.
+// Empty when source can't be read.
+std::string compute_direct_cache_key(const CompileJob& compile_job)
+{
+    const auto source_hash = sha256_file_content(compile_job.source_file);
+    if (source_hash.empty())
+    {
+        return {};
+    }
+
+    Sha256 hasher{};
+    hasher.update(std::format("{}\n{}\n{}\n{}\n", compiler_fingerprint(), compile_job.compile_flags.text(), compile_job.source_file.string(), source_hash));
+    if (has_debug_info_flag(compile_job.compile_flags.text()))
+    {
+        hasher.update(project_directory.string());  // debug info embeds compilation directory
+    }
+    return hasher.finish();
+}
+
+std::filesystem::path get_cache_manifest_file(const std::string& direct_key)
+{
+    return cache_directory / cache_manifests_directory / direct_key;
+}
+
+std::filesystem::path get_cache_entry_file(const std::string& result_key, const std::string_view& extension)
+{
+    return cache_directory / cache_objects_directory / std::format("{}{}", result_key, extension);
+}
+
+// Returns empty key when any of headers is missing
+std::string compute_cache_result_key(const std::string& direct_key, const std::vector<std::filesystem::path>& headers)
+{
+    Sha256 hasher{};
+    hasher.update(direct_key);
+    for (const auto& header : headers)
+    {
+        const auto header_hash = sha256_file_content(header);
+        if (header_hash.empty())
+        {
+            return {};
+        }
+        hasher.update(std::format("\n{}\n{}", header.string(), header_hash));
+    }
+    return hasher.finish();
+}
+
+// Output of job is printed as one block, so outputs of parallel jobs never interleave
+void print_job_output(const std::filesystem::path& job_output, const std::string& output)
+{
+    if (output.empty())
+    {
+        return;
+    }
+    std::fflush(stdout);  // keeps diagnostics after status line of job when both streams go to terminal
+    std::print(stderr, "{}Output of {}:{}\n{}", YELLOW_FONT, job_output.string(), RESET_FONT, output);
+}
+
+// Copies through temporary file, so other builds sharing the cache never see partially written entries
+void copy_file_atomically(const std::filesystem::path& source, const std::filesystem::path& destination)
+{
+    const auto temporary_file = std::filesystem::path{std::format("{}.{}.tmp", destination.string(), getpid())};
+    std::filesystem::copy_file(source, temporary_file, std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::rename(temporary_file, destination);
+}
+
+// Returns headers listed in manifest of restored entry, nothing on miss
+std::optional<std::vector<std::filesystem::path>> restore_from_cache(const CompileJob& compile_job, const std::string& direct_key)
+{
+    std::ifstream manifest{get_cache_manifest_file(direct_key)};
+    if (not manifest)
+    {
+        return std::nullopt;
+    }
+
+    std::vector<std::filesystem::path> headers{};
+    std::string line{};
+    while (std::getline(manifest, line))
+    {
+        headers.emplace_back(line);
+    }
+
+    const auto result_key = compute_cache_result_key(direct_key, headers);
+    const auto cached_object_file = get_cache_entry_file(result_key, object_file_extension);
+    if (result_key.empty() or not std::filesystem::exists(cached_object_file))
+    {
+        return std::nullopt;
+    }
+
+    try
+    {
+        std::filesystem::copy_file(cached_object_file, compile_job.object_file, std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::copy_file(get_cache_entry_file(result_key, depfile_extension), compile_job.object_file.string() + depfile_extension,
+            std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::copy_file(get_cache_entry_file(result_key, diagnostics_file_extension), compile_job.object_file.string() + diagnostics_file_extension,
+            std::filesystem::copy_options::overwrite_existing);
+    }
+    catch (const std::filesystem::filesystem_error& error)
+    {
+        trace_error(std::format("Could not restore {} from cache: {}", compile_job.object_file.string(), error.what()));
+        return std::nullopt;
+    }
+    print_job_output(compile_job.object_file, read_file_content(compile_job.object_file.string() + diagnostics_file_extension));
+    return headers;
+}
+
+// Expects header dependencies to be already collected from compiler depfile
+void store_in_cache(const CompileJob& compile_job, const std::string& direct_key)
+{
+    std::vector<std::filesystem::path> headers{};
+    for (const auto& dependency : compile_job.header_dependencies)
+    {
+        headers.push_back(dependency.header_file);
+    }
+
+    const auto result_key = compute_cache_result_key(direct_key, headers);
+    if (result_key.empty())
+    {
+        return;
+    }
+
+    try
+    {
+        create_directory_if_missing(cache_directory / cache_manifests_directory);
+        create_directory_if_missing(cache_directory / cache_objects_directory);
+
+        const auto object_file = compile_job.object_file.string();
+        copy_file_atomically(object_file + depfile_extension, get_cache_entry_file(result_key, depfile_extension));
+        copy_file_atomically(object_file + diagnostics_file_extension, get_cache_entry_file(result_key, diagnostics_file_extension));
+        copy_file_atomically(object_file, get_cache_entry_file(result_key, object_file_extension));
+
+        const auto manifest_file = get_cache_manifest_file(direct_key);
+        const auto temporary_manifest_file = std::format("{}.{}.tmp", manifest_file.string(), getpid());
+        if (std::ofstream manifest{temporary_manifest_file}; manifest)
+        {
+            for (const auto& header : headers)
+            {
+                std::println(manifest, "{}", header.string());
+            }
+        }
+        std::filesystem::rename(temporary_manifest_file, manifest_file);
+    }
+    catch (const std::filesystem::filesystem_error& error)
+    {
+        trace_error(std::format("Could not store {} in cache: {}", compile_job.object_file.string(), error.what()));
+    }
+}
+
+Target& find_target(const std::string_view& name)
+{
+    auto target = std::ranges::find(targets, name, &Target::name);
+    if (target == targets.end())
+    {
+        trace_error(std::format("Target {} does not exist!", name));
+        exit(-1);
+    }
+    return *target;
+}
+
+std::string get_archive_file_name(const Target& library)
+{
+    return std::format("lib{}.a", library.name);
+}
+
+bool is_newer_than(const std::filesystem::path& file, const std::filesystem::path& other_file)
+{
+    std::error_code error{};
+    const auto other_time = std::filesystem::last_write_time(other_file, error);
+    return error or std::filesystem::last_write_time(file, error) > other_time;
+}
+
+// Archive is updated in place with ar r, replacing only members whose objects were rebuilt in this build or after
+// last archive update. It's rewritten when its members or format change, as ar neither drops stale members nor
+// converts between regular and thin archive, and also when regular archive would hold two members of same file name.
+void prepare_target_archiving(Target& target, const std::filesystem::path& archive_file)
+{
+    std::string members{std::format("{}\n", target.thin_archive ? "thin" : "regular")};
+    std::set<std::filesystem::path> member_names{};
+    for (const auto& object_file : target.object_files)
+    {
+        members += object_file.string() + '\n';
+        member_names.insert(object_file.filename());
+    }
+    const bool unique_member_names = target.thin_archive or member_names.size() == target.object_files.size();
+
+    const auto members_file = archive_file.string() + archive_members_extension;
+    const auto existing_members = read_file_content(members_file);
+
+    std::set<std::filesystem::path> rebuilt_objects{};
+    for (const auto& job : target.build_jobs)
+    {
+        if (const auto* compile_job = std::get_if<CompileJob>(&job.specific_job))
+        {
+            rebuilt_objects.insert(compile_job->object_file);
+        }
+    }
+    auto is_outdated = [&](const std::filesystem::path& object_file)
+    {
+        return rebuilt_objects.contains(object_file) or is_newer_than(object_file, archive_file);
+    };
+
+    ArchiveJob archive_job{.archive_file = archive_file, .thin = target.thin_archive};
+    const bool members_unchanged = std::filesystem::exists(archive_file) and existing_members == members;
+    if (members_unchanged and unique_member_names)
+    {
+        std::ranges::copy_if(target.object_files, std::back_inserter(archive_job.object_files), is_outdated);
+    }
+    else if (not members_unchanged or std::ranges::any_of(target.object_files, is_outdated))
+    {
+        std::filesystem::remove(archive_file);
+        std::ofstream{members_file} << members;
+        archive_job.object_files = target.object_files;
+        archive_job.rewrite = true;
+    }
+
+    if (archive_job.object_files.empty())
+    {
+        return;
+    }
+    target.needs_linking = true;
+    Job archive_job_with_deps{.specific_job = archive_job, .pool = target.link_pool, .environment = target.environment,
+        .working_directory = target.working_directory};
+    for (size_t i = 0; i < target.build_jobs.size(); ++i)
+    {
+        archive_job_with_deps.depends_on.push_back(i);
+    }
+    target.build_jobs.push_back(archive_job_with_deps);
+}
+
+void prepare_target_linking(Target& target, const bool use_build_dir = true)
+{
+    TraceScope trace_scope{"prepare_target_linking", target.name};
+    auto canonical_build_dir = std::filesystem::canonical(build_directory);
+    if (not use_build_dir) canonical_build_dir = std::filesystem::canonical(current_directory);
+
+    if (target.type == TargetType::StaticLibrary)
+    {
+        prepare_target_archiving(target, canonical_build_dir / get_archive_file_name(target));
+        return;
+    }
+
+    auto link_job = LinkJob{};
+    link_job.target_file = (canonical_build_dir / target.name);
+    for (const auto& library_name : target.linked_libraries)
+    {
+        const auto& library = find_target(library_name);
+        link_job.libraries.push_back(canonical_build_dir / get_archive_file_name(library));
+        // Archive is updated in this build or was updated after target was last linked
+        target.needs_linking = target.needs_linking or library.needs_linking or is_newer_than(link_job.libraries.back(), link_job.target_file);
+    }
+
+    if (not target.needs_linking)
+    {
+        return;
+    }
+
+    link_job.object_files = target.object_files;
+
+    link_job.link_flags = ""; // TODO add link flags support to Target
+    
+    // Link job depends on all compile jobs
+    Job link_job_with_deps{.specific_job = link_job, .pool = target.link_pool, .environment = target.environment,
+        .working_directory = target.working_directory};
+    for (size_t i = 0; i < target.build_jobs.size(); ++i)
+    {
+        link_job_with_deps.depends_on.push_back(i);
+    }
+    target.build_jobs.push_back(link_job_with_deps);
+}
+
+// Merges build jobs of given targets into one graph, compile jobs producing same object file are run only once
+std::vector<Job> merge_target_build_jobs(const std::vector<Target*>& targets_to_merge)
+{
+    std::vector<Job> merged_jobs{};
+    std::map<std::filesystem::path, std::pair<size_t, const CompileJob*>> compile_job_indexes{};  // merged index and job first producing object
+    std::map<std::string, size_t> archive_job_indexes{};  // by library name, libraries are merged before targets linking them
+
+    for (auto* target : targets_to_merge)
+    {
+        // Dependencies may point forward, like importers of modules to module interfaces, so all indexes are assigned first
+        std::vector<size_t> merged_indexes(target->build_jobs.size());
+        std::vector<bool> is_duplicate(target->build_jobs.size());
+        auto next_index = merged_jobs.size();
+        for (size_t index = 0; index < target->build_jobs.size(); ++index)
+        {
+            if (const auto* compile_job = std::get_if<CompileJob>(&target->build_jobs[index].specific_job))
+            {
+                auto [found, inserted] = compile_job_indexes.try_emplace(compile_job->object_file, next_index, compile_job);
+                if (not inserted)
+                {
+                    if (not (*found->second.second == *compile_job))
+                    {
+                        trace_error(std::format("Object file {} of target {} is built by other target with different flags",
+                            compile_job->object_file.string(), target->name));
+                        exit(-1);
+                    }
+                    merged_indexes[index] = found->second.first;
+                    is_duplicate[index] = true;
+                    continue;
+                }
+            }
+            merged_indexes[index] = next_index++;
+        }
+
+        for (size_t index = 0; index < target->build_jobs.size(); ++index)
+        {
+            if (is_duplicate[index])
+            {
+                continue;
+            }
+
+            auto job = target->build_jobs[index];
+            job.target_name = target->name;
+            for (auto& dependency : job.depends_on)
+            {
+                dependency = merged_indexes[dependency];
+            }
+            if (std::holds_alternative<ArchiveJob>(job.specific_job))
+            {
+                archive_job_indexes[target->name] = merged_jobs.size();
+            }
+            else if (std::holds_alternative<LinkJob>(job.specific_job))
+            {
+                for (const auto& library_name : target->linked_libraries)
+                {
+                    if (const auto archive_job = archive_job_indexes.find(library_name); archive_job != archive_job_indexes.end())
+                    {
+                        job.depends_on.push_back(archive_job->second);
+                    }
+                }
+            }
+            merged_jobs.push_back(std::move(job));
+        }
+    }
+    return merged_jobs;
+}
+
+// Moves -ftime-report section printed by gcc at exit from job output to its own file
+void split_gcc_time_report(std::string& output, const std::filesystem::path& object_file)
+{
+    auto report_start = output.find("Time variable");
+    if (report_start == std::string::npos)
+    {
+        return;
+    }
+    report_start = output.rfind('\n', report_start) == std::string::npos ? 0 : output.rfind('\n', report_start) + 1;
+
+    std::ofstream{object_file.string() + time_report_extension} << output.substr(report_start);
+    output.erase(report_start);
+}
+
+// Moves include tree printed by -H from job output to its own file
+void split_include_tree(std::string& output, const std::filesystem::path& object_file)
+{
+    std::istringstream lines{output};
+    std::string include_tree{};
+    std::string diagnostics{};
+    bool in_include_guards_hint{false};
+    std::string line{};
+    while (std::getline(lines, line))
+    {
+        const auto depth = line.find_first_not_of('.');
+        if (depth != 0 and depth != std::string::npos and line[depth] == ' ')
+        {
+            include_tree.append(line).push_back('\n');
+        }
+        else if (line == "Multiple include guards may be useful for:")
+        {
+            in_include_guards_hint = true;
+        }
+        else if (not in_include_guards_hint or not std::filesystem::exists(line))
+        {
+            in_include_guards_hint = false;
+            diagnostics.append(line).push_back('\n');
+        }
+    }
 
-    for (const auto& source : target.sources)
+    std::ofstream{object_file.string() + include_tree_extension} << include_tree;
+    output = std::move(diagnostics);
+}
+
+// Compile times summed over translation units, in milliseconds
+struct TimeReport
+{
+    std::map<std::string, double> headers{};
+    std::map<std::string, double> instantiations{};
+    std::map<std::string, double> codegen{};
+    std::map<std::string, double> phases{};  // top level parts of compilation, together they make whole compile time
+    std::map<std::string, double> passes{};  // parts of phases, never mixed with them so no time is counted twice
+};
+
+void add_clang_time_trace(TimeReport& report, const std::filesystem::path& trace_file)
+{
+    const auto document = JsonParser{read_file_content(trace_file)}.parse();
+    const auto* events = document ? document->find("traceEvents") : nullptr;
+    if (not events or not events->as_array())
+    {
+        return;
+    }
+
+    for (const auto& event : *events->as_array())
     {
-        // Determine object file path
-        std::filesystem::path relative_source_path{};
-        if (source.is_absolute())
+        const auto* name = event.find("name");
+        const auto* duration = event.find("dur");
+        if (not name or not name->as_string() or not duration)
         {
-            relative_source_path = std::filesystem::relative(source, project_directory);
+            continue;
         }
-        else
+        const auto milliseconds = duration->as_number() / 1000.0;
+        const auto* args = event.find("args");
+        const auto* detail = args ? args->find("detail") : nullptr;
+        const auto detail_string = detail and detail->as_string() ? *detail->as_string() : std::string{};
+
+        if (*name->as_string() == "Source") report.headers[detail_string] += milliseconds;
+        else if (name->as_string()->starts_with("Instantiate")) report.instantiations[detail_string] += milliseconds;
+        else if (*name->as_string() == "CodeGen Function" or *name->as_string() == "OptFunction") report.codegen[detail_string] += milliseconds;
+        else if (*name->as_string() == "Total Frontend" or *name->as_string() == "Total Backend") report.phases[name->as_string()->substr(6)] += milliseconds;
+        else if (name->as_string()->starts_with("Total ") and *name->as_string() != "Total ExecuteCompiler") report.passes[name->as_string()->substr(6)] += milliseconds;
+    }
+}
+
+// Lines of gcc report look like "name : usr ( %) sys ( %) wall ( %) GGC ( %)"
+void add_gcc_time_report(TimeReport& report, const std::filesystem::path& report_file)
+{
+    std::ifstream file{report_file};
+    std::string line{};
+    while (std::getline(file, line))
+    {
+        const auto separator = line.find(':');
+        if (separator == std::string::npos)
+        {
+            continue;
+        }
+        auto values = line.substr(separator + 1);
+        std::ranges::replace_if(values, [](const char character) { return character == '(' or character == ')' or character == '%'; }, ' ');
+        std::istringstream fields{values};
+        double user{}, user_percent{}, system{}, system_percent{}, wall{};
+        if (fields >> user >> user_percent >> system >> system_percent >> wall)
         {
-            relative_source_path = source;
+            auto name = line.substr(0, separator);
+            name.erase(name.find_last_not_of(' ') + 1);
+            name.erase(0, name.find_first_not_of(' '));
+            // Every timevar belongs to one of "phase ..." entries, which sum up to TOTAL
+            if (name.starts_with("phase ")) report.phases[name.substr(6)] += wall * 1000.0;
+            else if (name != "TOTAL") report.passes[name] += wall * 1000.0;
         }
+    }
+}
 
-        auto build_source_object_file = (canonical_build_dir / relative_source_path).string() + object_file_extension;
-        link_job.object_files.push_back(build_source_object_file);
+void print_time_report_section(const std::string_view& title, const std::map<std::string, double>& times)
+{
+    constexpr size_t max_entries = 10;
+    if (times.empty())
+    {
+        return;
     }
 
-    link_job.target_file = (canonical_build_dir / target.name);
-    link_job.link_flags = ""; // TODO add link flags support to Target
-    
-    // Link job depends on all compile jobs
-    Job link_job_with_deps{.specific_job = link_job};
-    for (size_t i = 0; i < target.build_jobs.size(); ++i)
+    std::vector<std::pair<std::string, double>> ranked{times.begin(), times.end()};
+    std::ranges::sort(ranked, std::greater{}, &std::pair<std::string, double>::second);
+    std::println("{}{}:{}", YELLOW_FONT, title, RESET_FONT);
+    for (const auto& [name, milliseconds] : ranked | std::views::take(max_entries))
     {
-        link_job_with_deps.depends_on.push_back(i);
+        std::println("{:>10} ms  {}", static_cast<uint64_t>(milliseconds), name);
     }
-    target.build_jobs.push_back(link_job_with_deps);
 }
 
-void run_build(Target& target)
+// Summarizes time reports of compile jobs run in this build
+void print_time_report(const std::vector<Job>& build_jobs)
+{
+    TimeReport report{};
+    for (const auto& job : build_jobs)
+    {
+        if (const auto* compile_job = std::get_if<CompileJob>(&job.specific_job); compile_job and job.status == Job::Status::Completed)
+        {
+            if (is_clang_compiler()) add_clang_time_trace(report, compile_job->object_file.string() + time_trace_extension);
+            else add_gcc_time_report(report, compile_job->object_file.string() + time_report_extension);
+        }
+    }
+
+    print_time_report_section("Most expensive compilation phases", report.phases);
+    print_time_report_section("Most expensive compiler passes", report.passes);
+    print_time_report_section("Most expensive headers (including nested headers)", report.headers);
+    print_time_report_section("Most expensive template instantiations", report.instantiations);
+    print_time_report_section("Most expensive function code generation", report.codegen);
+}
+
+std::filesystem::path get_job_output(const Job& job)
+{
+    if (const auto* compile_job = std::get_if<CompileJob>(&job.specific_job))
+    {
+        return compile_job->object_file;
+    }
+    if (const auto* archive_job = std::get_if<ArchiveJob>(&job.specific_job))
+    {
+        return archive_job->archive_file;
+    }
+    return std::get<LinkJob>(job.specific_job).target_file;
+}
+
+// One finished job in append-only build log, times are milliseconds since epoch
+struct BuildLogEntry
+{
+    uint64_t start_milliseconds{};
+    uint64_t end_milliseconds{};
+    int exit_code{};
+    uint64_t command_hash{};
+    uint64_t output_stamp{};  // hash of mtime, size and inode of output, content isn't read in event loop; 0 when job failed
+    uint64_t peak_memory_kib{};  // maximum resident set size
+    std::filesystem::path output{};
+};
+
+std::vector<BuildLogEntry> read_build_log(const std::filesystem::path& log_file)
+{
+    std::vector<BuildLogEntry> entries{};
+    std::ifstream file{log_file};
+    std::string line{};
+    if (not std::getline(file, line) or line != build_log_header)
+    {
+        return entries;
+    }
+
+    while (std::getline(file, line))
+    {
+        std::istringstream fields{line};
+        BuildLogEntry entry{};
+        fields >> entry.start_milliseconds >> entry.end_milliseconds >> entry.exit_code >> std::hex >> entry.command_hash >> entry.output_stamp >> std::dec >> entry.peak_memory_kib;
+        std::string output{};
+        if (fields and std::getline(fields >> std::ws, output))
+        {
+            entry.output = output;
+            entries.push_back(std::move(entry));
+        }
+    }
+    return entries;
+}
+
+void write_build_log_entry(std::ostream& file, const BuildLogEntry& entry)
+{
+    std::println(file, "{}\t{}\t{}\t{:x}\t{:x}\t{}\t{}", entry.start_milliseconds, entry.end_milliseconds, entry.exit_code,
+        entry.command_hash, entry.output_stamp, entry.peak_memory_kib, entry.output.string());
+}
+
+// Rewrites log keeping only newest entries of every output, when it grew twice over that size
+void compact_build_log(const std::filesystem::path& log_file, const std::vector<BuildLogEntry>& entries)
+{
+    std::map<std::filesystem::path, size_t> newer_entries{};
+    std::vector<const BuildLogEntry*> kept_entries{};
+    for (const auto& entry : entries | std::views::reverse)
+    {
+        if (newer_entries[entry.output]++ < build_log_history_size)
+        {
+            kept_entries.push_back(&entry);
+        }
+    }
+    if (entries.size() < 2 * kept_entries.size())
+    {
+        return;
+    }
+
+    const auto temporary_log_file = log_file.string() + ".tmp";
+    {
+        std::ofstream file{temporary_log_file};
+        std::println(file, "{}", build_log_header);
+        for (const auto* entry : kept_entries | std::views::reverse)
+        {
+            write_build_log_entry(file, *entry);
+        }
+    }
+    std::filesystem::rename(temporary_log_file, log_file);
+}
+
+std::ofstream open_build_log(const std::filesystem::path& log_file)
+{
+    const bool is_new = not std::filesystem::exists(log_file);
+    std::ofstream file{log_file, std::ios::app};
+    if (is_new)
+    {
+        std::println(file, "{}", build_log_header);
+    }
+    return file;
+}
+
+// Durations of last successful runs of jobs, identified by their output file
+std::map<std::filesystem::path, uint64_t> get_job_durations(const std::vector<BuildLogEntry>& entries)
+{
+    std::map<std::filesystem::path, uint64_t> durations{};
+    for (const auto& entry : entries)
+    {
+        if (entry.exit_code == 0)
+        {
+            durations[entry.output] = entry.end_milliseconds - entry.start_milliseconds;
+        }
+    }
+    return durations;
+}
+
+// Peak memory of last successful run of every job, jobs without history are expected to need average of others
+std::vector<uint64_t> predict_job_memory(const std::vector<Job>& build_jobs, const std::vector<BuildLogEntry>& entries)
+{
+    std::map<std::filesystem::path, uint64_t> peak_memory{};
+    for (const auto& entry : entries)
+    {
+        if (entry.exit_code == 0 and entry.peak_memory_kib != 0)
+        {
+            peak_memory[entry.output] = entry.peak_memory_kib;
+        }
+    }
+    const auto recorded_memory = std::accumulate(peak_memory.begin(), peak_memory.end(), uint64_t{},
+        [](const uint64_t sum, const auto& job_memory) { return sum + job_memory.second; });
+    const auto average_memory = peak_memory.empty() ? 0 : recorded_memory / peak_memory.size();
+
+    std::vector<uint64_t> predicted_memory{};
+    for (const auto& job : build_jobs)
+    {
+        const auto job_memory = peak_memory.find(get_job_output(job));
+        predicted_memory.push_back(job_memory != peak_memory.end() ? job_memory->second : average_memory);
+    }
+    return predicted_memory;
+}
+
+// Accepts sizes like "512M" or "16G", returns KiB
+std::optional<uint64_t> parse_memory_size(const std::string_view& size)
+{
+    uint64_t value{};
+    const auto [end, error] = std::from_chars(size.data(), size.data() + size.size(), value);
+    if (error != std::errc{})
+    {
+        return std::nullopt;
+    }
+    const auto unit = std::string_view{end, size.data() + size.size()};
+    if (unit == "K" or unit.empty()) return value;
+    if (unit == "M") return value * 1024;
+    if (unit == "G") return value * 1024 * 1024;
+    return std::nullopt;
+}
+
+uint64_t estimate_job_milliseconds(const Job& job, const std::map<std::filesystem::path, uint64_t>& durations)
+{
+    if (const auto duration = durations.find(get_job_output(job)); duration != durations.end())
+    {
+        return duration->second;
+    }
+    if (const auto* compile_job = std::get_if<CompileJob>(&job.specific_job))
+    {
+        return static_cast<uint64_t>(count_lines(compile_job->source_file) * default_milliseconds_per_line);
+    }
+    return default_link_milliseconds;
+}
+
+// Reversed dependency graph, indices of jobs depending on every job
+std::vector<std::vector<size_t>> find_dependent_jobs(const std::vector<Job>& build_jobs)
+{
+    std::vector<std::vector<size_t>> dependents(build_jobs.size());
+    for (size_t index = 0; index < build_jobs.size(); ++index)
+    {
+        for (const auto dependency : build_jobs[index].depends_on)
+        {
+            dependents[dependency].push_back(index);
+        }
+    }
+    return dependents;
+}
+
+// Orders jobs by longest estimated path to the end of build, so slow chains are started first
+std::vector<size_t> plan_scheduling_order(const std::vector<Job>& build_jobs, const std::map<std::filesystem::path, uint64_t>& durations)
+{
+    const auto dependents = find_dependent_jobs(build_jobs);
+
+    std::vector<std::optional<uint64_t>> critical_paths(build_jobs.size());
+    std::function<uint64_t(size_t)> critical_path = [&](size_t index)
+    {
+        if (not critical_paths[index])
+        {
+            uint64_t longest_dependent_path{};
+            for (const auto dependent : dependents[index])
+            {
+                longest_dependent_path = std::max(longest_dependent_path, critical_path(dependent));
+            }
+            critical_paths[index] = estimate_job_milliseconds(build_jobs[index], durations) + longest_dependent_path;
+        }
+        return *critical_paths[index];
+    };
+
+    std::vector<size_t> order(build_jobs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order, std::greater{}, critical_path);
+    return order;
+}
+
+// Job slots shared with other processes through GNU make jobserver protocol. Every process owns one
+// implicit slot, each further running job needs token read from jobserver and written back when it ends.
+struct Jobserver
+{
+    int read_fd{-1};  // non-blocking, not connected when -1
+    int write_fd{-1};
+    std::string held_tokens{};  // tokens have to be returned exactly as they were read
+    std::filesystem::path fifo{};  // created when nobs itself is jobserver
+};
+
+static Jobserver jobserver{};
+
+// Last --jobserver-auth (or older --jobserver-fds) option of MAKEFLAGS wins, like in make itself
+std::optional<std::string> find_jobserver_auth(const std::string_view& makeflags)
+{
+    std::optional<std::string> auth{};
+    std::istringstream flags{std::string{makeflags}};
+    std::string flag{};
+    while (flags >> flag)
+    {
+        for (const auto* option : {"--jobserver-auth=", "--jobserver-fds="})
+        {
+            if (flag.starts_with(option))
+            {
+                auth = flag.substr(std::string_view{option}.size());
+            }
+        }
+    }
+    return auth;
+}
+
+void release_all_jobserver_tokens()
+{
+    for (const char token : jobserver.held_tokens)
+    {
+        while (write(jobserver.write_fd, &token, 1) == -1 and errno == EINTR) {}
+    }
+    jobserver.held_tokens.clear();
+    if (not jobserver.fifo.empty())
+    {
+        unlink(jobserver.fifo.c_str());
+    }
+}
+
+// Connects to "fifo:PATH" or "R,W" pipe jobserver. Pipe is reopened, so making it non-blocking doesn't affect other clients.
+bool connect_to_jobserver(const std::string& auth)
+{
+    if (auth.starts_with("fifo:"))
+    {
+        jobserver.read_fd = open(auth.substr(5).c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        jobserver.write_fd = jobserver.read_fd;
+    }
+    else if (int read_fd{}, write_fd{}; std::sscanf(auth.c_str(), "%d,%d", &read_fd, &write_fd) == 2 and fcntl(write_fd, F_GETFD) != -1)
+    {
+        jobserver.read_fd = open(std::format("/proc/self/fd/{}", read_fd).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        jobserver.write_fd = write_fd;
+    }
+
+    if (jobserver.read_fd == -1)
+    {
+        std::println("{}Could not connect to jobserver {}, running without it.{}", YELLOW_FONT, auth, RESET_FONT);
+        return false;
+    }
+    std::atexit(release_all_jobserver_tokens);
+    return true;
+}
+
+// Fifo with token for every job slot except the implicit one, announced to spawned processes through MAKEFLAGS
+void start_jobserver(const size_t slots)
+{
+    create_directory_if_missing(build_directory);
+    const auto fifo = std::filesystem::absolute(build_directory / jobserver_fifo);
+    unlink(fifo.c_str());
+    if (mkfifo(fifo.c_str(), 0600) != 0 or not connect_to_jobserver(std::format("fifo:{}", fifo.string())))
+    {
+        trace_error(std::format("Could not create jobserver fifo {}", fifo.string()));
+        return;
+    }
+    jobserver.fifo = fifo;
+    const std::string tokens(slots - 1, jobserver_token);
+    if (not tokens.empty() and write(jobserver.write_fd, tokens.data(), tokens.size()) != static_cast<ssize_t>(tokens.size()))
+    {
+        trace_error("Could not fill jobserver with tokens");
+    }
+
+    const auto* makeflags = std::getenv("MAKEFLAGS");
+    setenv("MAKEFLAGS", std::format("{} -j{} --jobserver-auth=fifo:{}", makeflags ? makeflags : "", slots, fifo.string()).c_str(), 1);
+}
+
+// Descriptors opened without O_CLOEXEC, like streams of nobs or ones inherited from its parent, would leak into every
+// spawned job. Only stdio and pipe jobserver descriptors announced in MAKEFLAGS are left inheritable.
+void set_close_on_exec_for_open_descriptors()
+{
+    std::set<int> inheritable{STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    const char* makeflags = std::getenv("MAKEFLAGS");
+    int read_fd{}, write_fd{};
+    if (const auto auth = find_jobserver_auth(makeflags ? makeflags : ""); auth and std::sscanf(auth->c_str(), "%d,%d", &read_fd, &write_fd) == 2)
+    {
+        inheritable.insert({read_fd, write_fd});
+    }
+
+    std::error_code error{};
+    for (const auto& entry : std::filesystem::directory_iterator{open_descriptors_directory, error})
+    {
+        int fd{};
+        const auto name = entry.path().filename().string();
+        if (std::from_chars(name.data(), name.data() + name.size(), fd).ec != std::errc{} or inheritable.contains(fd))
+        {
+            continue;
+        }
+        if (const int flags = fcntl(fd, F_GETFD); flags != -1 and not (flags & FD_CLOEXEC))
+        {
+            fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+        }
+    }
+}
+
+void install_child_exit_handler()
+{
+    if (child_exit_pipe[0] != -1)
+    {
+        return;
+    }
+    if (pipe2(child_exit_pipe, O_CLOEXEC | O_NONBLOCK) == -1)
+    {
+        trace_error("Failed to create pipe for child exit notifications");
+        exit(-1);
+    }
+    struct sigaction action{};
+    action.sa_handler = notify_child_exit;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGCHLD, &action, nullptr);
+}
+
+void setup_jobserver()
+{
+    static bool done{false};
+    if (done)
+    {
+        return;
+    }
+    done = true;
+
+    const auto* makeflags = std::getenv("MAKEFLAGS");
+    if (const auto auth = find_jobserver_auth(makeflags ? makeflags : ""))
+    {
+        connect_to_jobserver(*auth);
+    }
+    else if (jobserver_enabled)
+    {
+        start_jobserver(parallel_jobs);
+    }
+}
+
+// Makes sure there is slot for one more job besides running ones, reading token from jobserver when needed
+bool reserve_jobserver_slot(const size_t running_jobs)
+{
+    if (jobserver.read_fd == -1 or running_jobs == 0 or jobserver.held_tokens.size() >= running_jobs)
+    {
+        return true;
+    }
+
+    char token{};
+    ssize_t result{};
+    while ((result = read(jobserver.read_fd, &token, 1)) == -1 and errno == EINTR) {}
+    if (result != 1)
+    {
+        return false;  // EAGAIN when other processes hold all tokens
+    }
+    jobserver.held_tokens.push_back(token);
+    return true;
+}
+
+// Returns tokens not needed by running jobs, so other processes can use them
+void release_unused_jobserver_tokens(const size_t running_jobs)
+{
+    const auto needed_tokens = running_jobs > 0 ? running_jobs - 1 : 0;
+    while (jobserver.held_tokens.size() > needed_tokens)
+    {
+        const char token = jobserver.held_tokens.back();
+        while (write(jobserver.write_fd, &token, 1) == -1 and errno == EINTR) {}
+        jobserver.held_tokens.pop_back();
+    }
+}
+
+// Values missing on systems without PSI or procfs don't affect number of jobs
+struct SystemLoad
+{
+    std::optional<double> load_average{};  // last minute, of whole host
+    double online_cpus{1.0};  // of whole host, load average is relative to them and not to CPU quota of nobs
+    std::optional<double> cpu_pressure{};
+    std::optional<double> memory_pressure{};
+};
+
+// Reads "some avg10=..." line of pressure stall information
+std::optional<double> read_pressure(const std::filesystem::path& pressure_file)
+{
+    std::ifstream file{pressure_file};
+    std::string kind{};
+    std::string average{};
+    if (file >> kind >> average and kind == "some" and average.starts_with("avg10="))
+    {
+        return std::stod(average.substr(6));
+    }
+    return std::nullopt;
+}
+
+// Pressure of own cgroup is preferred, in container it tells how much jobs of nobs are held back and not the rest of host
+SystemLoad read_system_load()
+{
+    auto cpu_pressure = read_pressure(cpu_pressure_file);
+    auto memory_pressure = read_pressure(memory_pressure_file);
+    if (const auto own_cgroup = find_own_cgroup())
+    {
+        const auto cgroup = std::filesystem::path{cgroup_root_directory} / *own_cgroup;
+        if (const auto pressure = read_pressure(cgroup / cgroup_cpu_pressure_file)) cpu_pressure = pressure;
+        if (const auto pressure = read_pressure(cgroup / cgroup_memory_pressure_file)) memory_pressure = pressure;
+    }
+    SystemLoad load{.online_cpus = static_cast<double>(std::max<long>(sysconf(_SC_NPROCESSORS_ONLN), 1)),
+        .cpu_pressure = cpu_pressure, .memory_pressure = memory_pressure};
+    std::ifstream file{load_average_file};
+    if (double load_average{}; file >> load_average)
+    {
+        load.load_average = load_average;
+    }
+    return load;
+}
+
+// Backs off by one job while CPU or memory is contended, grows back up to parallel_jobs when system is idle enough
+// Running jobs of nobs are taken out of load average, they are what limit is adapted for
+size_t adapt_job_limit(const size_t job_limit, const SystemLoad& load, const size_t running_jobs)
+{
+    const auto cpus = load.online_cpus;
+    const auto other_load = std::max(load.load_average.value_or(0.0) - static_cast<double>(running_jobs), 0.0);
+    const bool overloaded = load.memory_pressure.value_or(0.0) > memory_pressure_limit or
+        load.cpu_pressure.value_or(0.0) > cpu_pressure_limit or
+        other_load > 1.5 * cpus;
+    const bool underloaded = load.memory_pressure.value_or(0.0) < memory_pressure_limit / 2 and
+        load.cpu_pressure.value_or(0.0) < cpu_pressure_limit / 2 and
+        other_load + static_cast<double>(running_jobs) < cpus;
+
+    if (overloaded and job_limit > 1)
+    {
+        return job_limit - 1;
+    }
+    if (underloaded and job_limit < parallel_jobs)
+    {
+        return job_limit + 1;
+    }
+    return std::min(job_limit, parallel_jobs);
+}
+
+// Marks jobs depending directly or indirectly on failed job as skipped, returns how many were skipped
+size_t skip_dependent_jobs(std::vector<Job>& build_jobs, const std::vector<std::vector<size_t>>& dependents, const size_t failed_job_index)
+{
+    size_t skipped_jobs{};
+    std::vector<size_t> unusable_jobs{failed_job_index};
+    while (not unusable_jobs.empty())
+    {
+        const auto unusable_job = unusable_jobs.back();
+        unusable_jobs.pop_back();
+        for (const auto index : dependents[unusable_job])
+        {
+            if (build_jobs[index].status == Job::Status::Pending)
+            {
+                build_jobs[index].status = Job::Status::Skipped;
+                skipped_jobs++;
+                unusable_jobs.push_back(index);
+            }
+        }
+    }
+    return skipped_jobs;
+}
+
+void run_build(std::vector<Job>& build_jobs, const std::string_view& name)
 {
-    const auto jobs_count = target.build_jobs.size();
+    const auto jobs_count = build_jobs.size();
     if (jobs_count == 0)
     {
-        std::println("{}Nothing to build for target {}{}{}.{}", GREEN_FONT, RED_FONT, target.name, GREEN_FONT, RESET_FONT);
+        std::println("{}Nothing to build for {}{}{}.{}", GREEN_FONT, RED_FONT, name, GREEN_FONT, RESET_FONT);
         return;
     }
-    std::println("{}Running build of {}{}{} with {} jobs (max {} parallel)...{}", GREEN_FONT, RED_FONT, target.name, GREEN_FONT, jobs_count, parallel_jobs, RESET_FONT);
+    std::println("{}Running build of {}{}{} with {} jobs (max {} parallel)...{}", GREEN_FONT, RED_FONT, name, GREEN_FONT, jobs_count, parallel_jobs, RESET_FONT);
     
+    const auto build_start = std::chrono::steady_clock::now();
+    const auto log_file = build_directory / build_log_file;
+    const auto log_entries = read_build_log(log_file);
+    std::vector<size_t> scheduling_order{};
+    {
+        TraceScope trace_scope{"plan_scheduling_order", std::string{name}};
+        scheduling_order = plan_scheduling_order(build_jobs, get_job_durations(log_entries));
+    }
+    compact_build_log(log_file, log_entries);
+    auto build_log = open_build_log(log_file);
+    set_close_on_exec_for_open_descriptors();
+    install_child_exit_handler();
+
     std::vector<PendingJob> pending_jobs;
-    size_t completed_jobs = 0;
+    size_t completed_jobs = 0;  // finished, failed and skipped
+    std::vector<std::pair<std::string, int>> failed_jobs{};  // commands with their exit codes
+    size_t skipped_jobs = 0;
+    auto stop_requested = [&]() { return max_failed_jobs != 0 and failed_jobs.size() >= max_failed_jobs; };
+    const auto dependents = find_dependent_jobs(build_jobs);
+    auto fail_job = [&](const size_t index, const std::string& command_display)
+    {
+        build_jobs[index].status = Job::Status::Failed;
+        failed_jobs.emplace_back(command_display, build_jobs[index].exit_code);
+        const auto newly_skipped_jobs = skip_dependent_jobs(build_jobs, dependents, index);
+        skipped_jobs += newly_skipped_jobs;
+        completed_jobs += newly_skipped_jobs;
+        std::println("{}Error: Command failed with code {}.{}{}", RED_FONT, build_jobs[index].exit_code,
+            stop_requested() ? " Waiting for running jobs and stopping build." : "", RESET_FONT);
+    };
+    const auto predicted_memory = predict_job_memory(build_jobs, log_entries);
+    uint64_t running_memory_kib{};
+    size_t job_limit = parallel_jobs;
+    std::map<std::string, size_t> running_pool_jobs{};
+    auto pool_is_full = [&](const std::string& pool)
+    {
+        const auto depth = job_pools.find(pool);
+        return depth != job_pools.end() and running_pool_jobs[pool] >= depth->second;
+    };
+    auto last_adaptation = build_start;
+    bool waiting_for_jobserver{false};
+    setup_jobserver();
+    std::vector<bool> busy_slots{};
+    std::vector<std::chrono::steady_clock::time_point> finish_times(jobs_count, build_start);
     
-    while (completed_jobs < jobs_count)
+    while (completed_jobs < jobs_count and not (stop_requested() and pending_jobs.empty()))
     {
         for (auto it = pending_jobs.begin(); it != pending_jobs.end(); )
         {
             int status;
-            pid_t result = waitpid(it->pid, &status, WNOHANG);
+            struct rusage usage{};
+            pid_t result = wait4(it->pid, &status, WNOHANG, &usage);
             
             if (result == it->pid)  // Child process completed
             {
-                auto& job = target.build_jobs[it->job_index];
+                auto& job = build_jobs[it->job_index];
                 int exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
                 job.exit_code = exit_code;
-                
-                if (exit_code != 0)
+
+                const auto output = get_job_output(job);
+                read_job_output(*it);
+                if (it->output_fd != -1)
+                {
+                    close(it->output_fd);  // still held open by some leftover child of job
+                }
+                if (it->is_compile_job and time_report and not is_clang_compiler())
+                {
+                    split_gcc_time_report(it->output, output);
+                }
+                if (it->is_compile_job and include_report)
+                {
+                    split_include_tree(it->output, output);
+                }
+                std::ofstream{output.string() + diagnostics_file_extension} << it->output;
+                print_job_output(output, it->output);
+
+                const auto milliseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - it->start_time).count());
+                const auto end_milliseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count());
+                write_build_log_entry(build_log, BuildLogEntry{
+                    .start_milliseconds = end_milliseconds - milliseconds,
+                    .end_milliseconds = end_milliseconds,
+                    .exit_code = exit_code,
+                    .command_hash = hash_bytes(0, it->command_display),
+                    .output_stamp = exit_code == 0 ? hash_file_stamp(output) : 0,
+                    .peak_memory_kib = static_cast<uint64_t>(usage.ru_maxrss),
+                    .output = output});
+                running_memory_kib -= predicted_memory[it->job_index];
+                running_pool_jobs[job.pool]--;
+                build_log.flush();
+
+                finish_times[it->job_index] = std::chrono::steady_clock::now();
+                busy_slots[it->slot] = false;
+                auto ready_time = build_start;
+                for (const auto dependency : job.depends_on)
+                {
+                    ready_time = std::max(ready_time, finish_times[dependency]);
+                }
+                record_trace_event({output.filename().string(), it->is_compile_job ? "compile" : "link", it->slot + 1,
+                    it->start_time, finish_times[it->job_index], {
+                        {"command", it->command_display},
+                        {"target", job.target_name},
+                        {"wait_ms", std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(it->start_time - ready_time).count())},
+                        {"run_ms", std::to_string(milliseconds)},
+                        {"peak_rss_kib", std::to_string(usage.ru_maxrss)},
+                        {"exit_code", std::to_string(exit_code)}}});
+                if (it->is_compile_job)
                 {
-                    job.status = Job::Status::Failed;
-                    std::println("{}Error: Command failed with code {}. Stopping build.{}", RED_FONT, exit_code, RESET_FONT);
-                    exit(exit_code);
+                    record_unity_job_result(std::get<CompileJob>(job.specific_job).object_file, exit_code == 0, milliseconds);
                 }
                 
-                job.status = Job::Status::Completed;
                 completed_jobs++;
+                if (exit_code != 0)
+                {
+                    fail_job(it->job_index, it->command_display);
+                }
+                else
+                {
+                    job.status = Job::Status::Completed;
+                }
                 
-                if (it->is_compile_job)
+                if (it->is_compile_job and exit_code == 0)
                 {
-                    auto specific_job = std::get<CompileJob>(job.specific_job);
-                    write_compile_job_to_file(specific_job);
+                    auto& specific_job = std::get<CompileJob>(job.specific_job);
+                    collect_header_dependencies(specific_job, it->start_timestamp);
+                    record_compile_job(specific_job);
+                    if (not it->cache_key.empty())
+                    {
+                        store_in_cache(specific_job, it->cache_key);
+                    }
                 }
                 
+                if (it->pidfd != -1)
+                {
+                    close(it->pidfd);
+                }
                 it = pending_jobs.erase(it);
             }
             else
@@ -482,21 +4160,49 @@ void run_build(Target& target)
             }
         }
         
+        if (adaptive_jobs and std::chrono::steady_clock::now() - last_adaptation >= std::chrono::milliseconds{adaptive_jobs_interval_milliseconds})
+        {
+            last_adaptation = std::chrono::steady_clock::now();
+            if (const auto new_job_limit = adapt_job_limit(job_limit, read_system_load(), pending_jobs.size()); new_job_limit != job_limit)
+            {
+                std::println("{}Running up to {} parallel jobs.{}", YELLOW_FONT, new_job_limit, RESET_FONT);
+                job_limit = new_job_limit;
+            }
+        }
+
         // Spawn new jobs if we have capacity and dependencies are satisfied
-        while (pending_jobs.size() < parallel_jobs && completed_jobs + pending_jobs.size() < jobs_count)
+        waiting_for_jobserver = false;
+        while (not stop_requested() && pending_jobs.size() < job_limit && completed_jobs + pending_jobs.size() < jobs_count)
         {
+            if (not reserve_jobserver_slot(pending_jobs.size()))
+            {
+                waiting_for_jobserver = true;
+                break;
+            }
+
             bool found_ready_job = false;
             
-            for (size_t index = 0; index < jobs_count; ++index)
+            for (const auto index : scheduling_order)
             {
-                auto& job = target.build_jobs[index];
+                auto& job = build_jobs[index];
                 
                 if (job.status != Job::Status::Pending)
                 {
                     continue;
                 }
                 
-                if (!are_dependencies_satisfied(target.build_jobs, index))
+                if (!are_dependencies_satisfied(build_jobs, index))
+                {
+                    continue;
+                }
+
+                if (pool_is_full(job.pool))
+                {
+                    continue;
+                }
+
+                // Smaller jobs further in order may still fit, a single job is always admitted
+                if (memory_limit_kib != 0 and not pending_jobs.empty() and running_memory_kib + predicted_memory[index] > memory_limit_kib)
                 {
                     continue;
                 }
@@ -505,35 +4211,71 @@ void run_build(Target& target)
 
                 auto [command_args, is_compile_job] = build_job_command_args(job);
                 auto percent = compute_percent(completed_jobs, pending_jobs.size(), jobs_count);
-                auto color = is_compile_job ? GREEN_FONT_FAINT : GREEN_FONT;
-                auto type = is_compile_job ? "Compiling" : "Linking";
-
                 std::string command_display = join_command_display(command_args);
+
+                // Check compilation cache before spawning compiler
+                std::string cache_key{};
+                if (is_compile_job and not cache_directory.empty() and not std::get<CompileJob>(job.specific_job).uses_modules)
+                {
+                    auto& compile_job = std::get<CompileJob>(job.specific_job);
+                    const auto restore_timestamp = get_current_file_timestamp();
+                    cache_key = compute_direct_cache_key(compile_job);
+                    const auto restored_headers = cache_key.empty() ? std::nullopt : restore_from_cache(compile_job, cache_key);
+                    if (restored_headers)
+                    {
+                        print_job_status(percent, completed_jobs + pending_jobs.size() + 1, jobs_count, GREEN_FONT_FAINT, "Restored", command_display);
+                        finish_times[index] = std::chrono::steady_clock::now();
+                        record_trace_event({compile_job.object_file.filename().string(), "cache", 0, finish_times[index], finish_times[index],
+                            {{"command", command_display}, {"target", job.target_name}}});
+                        job.status = Job::Status::Completed;
+                        completed_jobs++;
+                        // Restored depfile names object of build directory it was stored from, manifest does not
+                        record_header_dependencies(compile_job, *restored_headers, restore_timestamp);
+                        record_compile_job(compile_job);
+                        break;  // Look for next ready job
+                    }
+                }
+
+                auto color = is_compile_job ? GREEN_FONT_FAINT : GREEN_FONT;
+                auto type = is_compile_job ? "Compiling" : std::holds_alternative<ArchiveJob>(job.specific_job) ? "Archiving" : "Linking";
                 print_job_status(percent, completed_jobs + pending_jobs.size() + 1, jobs_count, color, type, command_display);
 
                 job.status = Job::Status::Running;
+                if (direct_compilation and is_compile_job)
+                {
+                    use_frontend_command(command_args, job);
+                }
+                use_response_file(command_args, get_job_output(job));
 
-                // Fork and execute the command
-                pid_t pid = fork();
-                if (pid == -1)
+                int output_pipe[2];
+                if (pipe2(output_pipe, O_CLOEXEC) == -1)
                 {
-                    trace_error("Failed to fork process");
+                    trace_error("Failed to create pipe for job output");
                     exit(-1);
                 }
 
-                if (pid == 0)
+                const auto start_timestamp = get_current_file_timestamp();
+                const pid_t pid = spawn_process(command_args, output_pipe[1], job.environment, job.working_directory);
+                close(output_pipe[1]);
+                if (pid == -1)
                 {
-                    // Child process
-                    auto argv = build_argv(command_args);
-                    execvp(argv[0], argv.data());
-                    // If execvp returns, an error occurred
-                    trace_error("Failed to execute command");
-                    exit(-1);
+                    close(output_pipe[0]);
+                    job.exit_code = command_not_found_exit_code;
+                    completed_jobs++;
+                    fail_job(index, command_display);
+                    break;
                 }
                 else
                 {
-                    // Parent process - track the job
-                    pending_jobs.push_back({index, pid, command_display, is_compile_job});
+                    fcntl(output_pipe[0], F_SETFL, O_NONBLOCK);
+                    const auto free_slot = std::ranges::find(busy_slots, false);
+                    const auto slot = static_cast<size_t>(free_slot - busy_slots.begin());
+                    if (free_slot == busy_slots.end()) busy_slots.push_back(true);
+                    else *free_slot = true;
+                    running_memory_kib += predicted_memory[index];
+                    running_pool_jobs[job.pool]++;
+                    pending_jobs.push_back({index, pid, command_display, is_compile_job, cache_key, std::chrono::steady_clock::now(), start_timestamp, slot,
+                        open_pidfd(pid), output_pipe[0]});
                     break;  // Go back to check for completions
                 }
             }
@@ -543,13 +4285,53 @@ void run_build(Target& target)
                 break;  // No more ready jobs, wait for some to complete
             }
         }
+        release_unused_jobserver_tokens(pending_jobs.size());
         
-        // If we have pending jobs, wait a bit before checking again
-        if (!pending_jobs.empty())
+        if (pending_jobs.empty())
+        {
+            if (completed_jobs < jobs_count and not stop_requested())
+            {
+                trace_error(std::format("No job of {} can be started, dependencies can not be satisfied", name));
+                exit(-1);
+            }
+        }
+        else
+        {
+            wait_for_job_events(pending_jobs, adaptive_jobs ? adaptive_jobs_interval_milliseconds : -1,
+                waiting_for_jobserver ? jobserver.read_fd : -1);
+        }
+    }
+
+    if (content_hashing)
+    {
+        TraceScope trace_scope{"hash_compiled_inputs", std::string{name}};
+        hash_compiled_inputs(build_jobs);
+    }
+
+    if (time_report)
+    {
+        print_time_report(build_jobs);
+    }
+
+    if (not failed_jobs.empty())
+    {
+        std::println("{}Build of {} failed: {} jobs failed, {} skipped, {} not started.{}", RED_FONT, name, failed_jobs.size(), skipped_jobs,
+            jobs_count - completed_jobs, RESET_FONT);
+        for (const auto& [command_display, exit_code] : failed_jobs)
         {
-            usleep(10000);  // 10ms sleep to avoid busy-waiting
+            std::println("{}  [code {}] {}{}", RED_FONT, exit_code, command_display, RESET_FONT);
         }
+        exit(failed_jobs.front().second);
+    }
+}
+
+void run_build(Target& target)
+{
+    for (auto& job : target.build_jobs)
+    {
+        job.target_name = target.name;
     }
+    run_build(target.build_jobs, std::format("target {}", target.name));
 }
 
 void restart_itself(const std::string& binary_name)
@@ -575,6 +4357,15 @@ void clean_target_build_artifacts(const Target& target, const bool use_build_dir
         }
 
         std::filesystem::remove(object_file);
+        std::filesystem::remove(object_file.string() + depfile_extension);
+        std::filesystem::remove(object_file.string() + diagnostics_file_extension);
+    }
+    for (const auto& job : target.build_jobs)
+    {
+        if (not std::holds_alternative<CompileJob>(job.specific_job))
+        {
+            std::filesystem::remove(get_job_output(job).string() + diagnostics_file_extension);
+        }
     }
 }
 
@@ -592,11 +4383,132 @@ void add_target_include_directories(Target& target, const std::vector<std::strin
     }    
 }
 
+// Inputs with changed timestamp, size or inode are hashed, and only a changed content triggers recompilation
+void enable_content_hashing()
+{
+    internal::content_hashing = true;
+}
+
+// Compiled objects are shared between build directories through cache keyed on compiler, flags, source and headers content.
+// Default location is $NOBS_CACHE_DIR, $XDG_CACHE_HOME/nobs or ~/.cache/nobs.
+void enable_compilation_cache(const std::string_view& cache_dir = {})
+{
+    internal::cache_directory = cache_dir.empty() ? internal::default_cache_directory() : std::filesystem::path{cache_dir};
+}
+
+// Compiler reports time spent on every translation unit, summary is printed at the end of build
+void enable_time_report()
+{
+    internal::time_report = true;
+}
+
+// Compiler prints include tree of every translation unit, header costs are attached to targets after build
+void enable_include_report()
+{
+    internal::include_report = true;
+}
+
+// Compile jobs run clang -cc1 frontend directly instead of going through driver, which is asked once per flag set
+// with -### what it would run. Driver is still used for compilers running more than one process, like gcc.
+void enable_direct_compilation()
+{
+    internal::direct_compilation = true;
+}
+
+// Number of running jobs follows load average and pressure stall information, never exceeding parallel jobs limit
+void enable_adaptive_jobs()
+{
+    internal::adaptive_jobs = true;
+}
+
+// Jobs assigned to pool run at most depth at once, on top of the global parallel jobs limit.
+// Link jobs are in "link" pool by default, so adding it caps parallel links.
+void add_job_pool(const std::string_view& name, const size_t depth, const std::source_location location = std::source_location::current())
+{
+    if (depth == 0)
+    {
+        internal::trace_error(std::format("Job pool {} needs depth of at least 1", name), location);
+        exit(1);
+    }
+    internal::job_pools[std::string{name}] = depth;
+}
+
+void set_target_pool(Target& target, const std::string_view& pool, const std::source_location location = std::source_location::current())
+{
+    if (not internal::job_pools.contains(std::string{pool}))
+    {
+        internal::trace_error(std::format("Job pool {} does not exist!", pool), location);
+        exit(1);
+    }
+    target.pool = pool;
+}
+
+void set_target_link_pool(Target& target, const std::string_view& pool, const std::source_location location = std::source_location::current())
+{
+    if (not internal::job_pools.contains(std::string{pool}))
+    {
+        internal::trace_error(std::format("Job pool {} does not exist!", pool), location);
+        exit(1);
+    }
+    target.link_pool = pool;
+}
+
+// Command lines longer than threshold (in bytes) pass their arguments through @file, 0 always passes them directly
+void set_response_file_threshold(const size_t threshold)
+{
+    internal::response_file_threshold = threshold;
+}
+
+// Variable is set only for compiler and linker of target, in addition to environment of nobs
+void set_target_environment(Target& target, const std::string_view& name, const std::string_view& value)
+{
+    const auto entry = std::format("{}=", name);
+    std::erase_if(target.environment, [&](const auto& item) { return item.starts_with(entry); });
+    target.environment.push_back(entry + std::string{value});
+}
+
+// Compiler and linker of target are started in given directory, so files they write next to themselves land there.
+// Relative paths in compile flags are resolved against it, use absolute include directories to keep header dependencies tracked.
+void set_target_working_directory(Target& target, const std::filesystem::path& directory, const std::source_location location = std::source_location::current())
+{
+    if (not std::filesystem::is_directory(directory))
+    {
+        internal::trace_error(std::format("Working directory {} does not exist!", directory.string()), location);
+        exit(1);
+    }
+    target.working_directory = std::filesystem::canonical(directory);
+}
+
+// Nobs serves its job slots through GNU make jobserver fifo announced in MAKEFLAGS, so that spawned
+// processes like gcc -flto=jobserver share them. When nobs itself runs under jobserver, it is always its client.
+void enable_jobserver()
+{
+    internal::jobserver_enabled = true;
+}
+
+// Jobs are started only while sum of their peak memory recorded in previous builds fits in limit
+void set_memory_limit(const uint64_t limit_kib)
+{
+    internal::memory_limit_kib = limit_kib;
+}
+
+// Jobs not depending on failed ones keep running until given number of failures, 0 never stops.
+// All failures are reported at the end of build.
+void enable_keep_going(const size_t max_failed_jobs = 0)
+{
+    internal::max_failed_jobs = max_failed_jobs;
+}
+
 void set_compiler(const std::string_view& compiler_name)
 {
     internal::compiler = std::string(compiler_name);
 }
 
+void set_archiver(const std::string_view& archiver_name)
+{
+    internal::archiver = std::string(archiver_name);
+}
+
 void set_linker(const std::string_view& linker_name)
 {
     internal::linker = std::string(linker_name);
@@ -615,6 +4527,19 @@ void enable_command_line_params(const int argc, const char* argv[])
             std::println("usage: {}", argv[0]);
             std::println("  -c, --clean\t- cleans build artifacts");
             std::println("  -m, --jobs N\t- use N parallel jobs (default: {})", internal::parallel_jobs);
+            std::println("  --adaptive-jobs\t- run fewer jobs while CPU or memory is under pressure");
+            std::println("  --mem-limit SIZE\t- start jobs only while their peak memory from previous builds fits in SIZE, e.g. 16G");
+            std::println("  --link-jobs N\t- run at most N link jobs at once, limits \"{}\" job pool", internal::default_link_pool);
+            std::println("  --jobserver\t- share job slots with spawned processes, like gcc -flto=jobserver, through GNU make jobserver");
+            std::println("  -k, --keep-going N\t- stop starting jobs after N failures, 0 keeps going (default: {})", internal::max_failed_jobs);
+            std::println("  --content-hash\t- compare content hashes of inputs with changed timestamps");
+            std::println("  --no-unity\t- compile every source of unity build targets separately");
+            std::println("  --suggest-pch\t- print headers worth putting into precompiled header");
+            std::println("  --time-report\t- print where compiler spends time, collected with -ftime-trace (clang) or -ftime-report (gcc)");
+            std::println("  --include-report\t- print headers which are included most, collected with -H during compilation");
+            std::println("  --direct-compile\t- run clang -cc1 directly, skipping compiler driver process");
+            std::println("  --trace FILE\t- write build timeline in Chrome trace event format to FILE");
+            std::println("  --cache\t- reuse object files from local compilation cache (default: {})", internal::default_cache_directory().string());
             std::println("  -h, --help\t- shows this help");
             exit(0);
         }
@@ -622,6 +4547,100 @@ void enable_command_line_params(const int argc, const char* argv[])
         {
             internal::clean_mode = true;
         }
+        else if (param == "--content-hash")
+        {
+            internal::content_hashing = true;
+        }
+        else if (param == "--no-unity")
+        {
+            internal::unity_builds_enabled = false;
+        }
+        else if (param == "--suggest-pch")
+        {
+            internal::suggest_precompiled_headers = true;
+        }
+        else if (param == "--time-report")
+        {
+            internal::time_report = true;
+        }
+        else if (param == "--include-report")
+        {
+            internal::include_report = true;
+        }
+        else if (param == "--direct-compile")
+        {
+            internal::direct_compilation = true;
+        }
+        else if (param == "--trace")
+        {
+            if (i + 1 < argc)
+            {
+                internal::trace_file = std::filesystem::absolute(argv[++i]);
+                std::atexit(internal::write_trace_file);
+            }
+            else
+            {
+                internal::trace_error("--trace requires an argument");
+                exit(1);
+            }
+        }
+        else if (param == "--cache")
+        {
+            internal::cache_directory = internal::default_cache_directory();
+        }
+        else if (param == "--adaptive-jobs")
+        {
+            internal::adaptive_jobs = true;
+        }
+        else if (param == "--mem-limit")
+        {
+            const auto memory_limit = i + 1 < argc ? internal::parse_memory_size(argv[i + 1]) : std::nullopt;
+            if (not memory_limit)
+            {
+                internal::trace_error("--mem-limit requires size argument, like 512M or 16G");
+                exit(1);
+            }
+            internal::memory_limit_kib = *memory_limit;
+            ++i;  // Skip the next argument since we consumed it
+        }
+        else if (param == "--link-jobs")
+        {
+            try
+            {
+                internal::job_pools[internal::default_link_pool] = std::max<size_t>(std::stoull(i + 1 < argc ? argv[i + 1] : ""), 1);
+                ++i;  // Skip the next argument since we consumed it
+            }
+            catch (const std::exception& e)
+            {
+                internal::trace_error("--link-jobs requires number of jobs");
+                exit(1);
+            }
+        }
+        else if (param == "--jobserver")
+        {
+            internal::jobserver_enabled = true;
+        }
+        else if (param == "--keep-going" || param == "-k")
+        {
+            if (i + 1 < argc)
+            {
+                try
+                {
+                    internal::max_failed_jobs = std::stoull(argv[i + 1]);
+                    ++i;  // Skip the next argument since we consumed it
+                }
+                catch (const std::exception& e)
+                {
+                    internal::trace_error(std::format("Invalid number of failures: {}", argv[i + 1]));
+                    exit(1);
+                }
+            }
+            else
+            {
+                internal::trace_error("--keep-going/-k requires an argument");
+                exit(1);
+            }
+        }
         else if (param == "--jobs" || param == "-m")
         {
             if (i + 1 < argc)
@@ -652,6 +4671,35 @@ Target& add_executable(const std::string_view& name)
     return internal::targets.emplace_back(name);
 }
 
+// Objects of library are archived into lib<name>.a in build directory
+Target& add_static_library(const std::string_view& name)
+{
+    return internal::targets.emplace_back(name, TargetType::StaticLibrary);
+}
+
+// Target is linked with archive of library and relinked whenever archive changes. Archive is updated before
+// target is linked, also when target alone is built.
+void add_target_link_library(Target& target, const Target& library, const std::source_location location = std::source_location::current())
+{
+    if (library.type != TargetType::StaticLibrary)
+    {
+        internal::trace_error(std::format("Target {} is not a static library!", library.name), location);
+        exit(1);
+    }
+    if (target.type == TargetType::StaticLibrary)
+    {
+        internal::trace_error(std::format("Static library {} can't link other libraries!", target.name), location);
+        exit(1);
+    }
+    target.linked_libraries.push_back(library.name);
+}
+
+// Thin archive only references object files of library, so they aren't copied into it every time some of them change
+void set_target_thin_archive(Target& library, const bool thin = true)
+{
+    library.thin_archive = thin;
+}
+
 void set_build_directory(const std::string_view& build_dir)
 {
     internal::build_directory = std::string(build_dir);
@@ -682,6 +4730,32 @@ void add_target_source(Target& target,
     add_target_sources(target, {source}, location);
 }
 
+// Header is precompiled once per target and implicitly included in front of every target source
+void add_target_precompiled_header(Target& target,
+    const std::string_view& header,
+    const std::source_location location = std::source_location::current())
+{
+    if (not std::filesystem::exists(header))
+    {
+        internal::trace_error(std::format("Precompiled header {} does not exist!", header), location);
+        exit(1);
+    }
+    target.precompiled_header = std::filesystem::path(header);
+}
+
+// Sources are scanned for C++20 module dependencies, so module interfaces are compiled before their importers
+void enable_target_modules(Target& target)
+{
+    target.uses_modules = true;
+}
+
+// Sources are compiled in generated unity translation units, each taking about given time to compile.
+// Compile times are learned from previous builds, sources failing to compile in batch get compiled separately.
+void enable_target_unity_build(Target& target, const uint64_t batch_milliseconds = internal::default_unity_batch_milliseconds)
+{
+    target.unity_batch_milliseconds = batch_milliseconds;
+}
+
 void add_target_compile_flags(Target& target,
     const std::vector<std::string_view>& flags)
 {
@@ -707,9 +4781,73 @@ void build_target(Target& target)
     {
         const bool USE_BUILD_DIR {true};
 
+        for (const auto& library_name : target.linked_libraries)
+        {
+            if (auto& library = internal::find_target(library_name); not library.built)
+            {
+                build_target(library);
+            }
+        }
+        if (internal::suggest_precompiled_headers)
+        {
+            internal::print_precompiled_header_candidates(target);
+        }
         internal::prepare_target_compilation(target, USE_BUILD_DIR);
         internal::prepare_target_linking(target, USE_BUILD_DIR);
         internal::run_build(target);
+        if (internal::include_report)
+        {
+            internal::analyze_target_includes(target);
+            internal::print_header_costs(target);
+        }
+    }
+    target.built = true;
+}
+
+// Builds all targets not built yet as one job graph, so jobs of different targets run in parallel
+void build_all()
+{
+    if (internal::clean_mode)
+    {
+        std::filesystem::remove_all(internal::build_directory);
+        return;
+    }
+
+    const bool USE_BUILD_DIR {true};
+    std::vector<Target*> targets_to_build{};
+    // Libraries go first, targets linking them need to know whether their archives get updated
+    std::vector<Target*> libraries_first{};
+    for (auto& target : internal::targets)
+    {
+        libraries_first.push_back(&target);
+    }
+    std::ranges::stable_partition(libraries_first, [](const Target* target) { return target->type == TargetType::StaticLibrary; });
+    for (auto* target_to_build : libraries_first)
+    {
+        auto& target = *target_to_build;
+        if (target.built)
+        {
+            continue;
+        }
+        if (internal::suggest_precompiled_headers)
+        {
+            internal::print_precompiled_header_candidates(target);
+        }
+        internal::prepare_target_compilation(target, USE_BUILD_DIR);
+        internal::prepare_target_linking(target, USE_BUILD_DIR);
+        targets_to_build.push_back(&target);
+    }
+
+    auto build_jobs = internal::merge_target_build_jobs(targets_to_build);
+    internal::run_build(build_jobs, std::format("{} targets", targets_to_build.size()));
+    for (auto* target : targets_to_build)
+    {
+        if (internal::include_report)
+        {
+            internal::analyze_target_includes(*target);
+            internal::print_header_costs(*target);
+        }
+        target->built = true;
     }
 }
 
@@ -726,6 +4864,7 @@ void enable_self_rebuild(const std::source_location& location = std::source_loca
     const bool DONT_USE_BUILD_DIR {false};
     internal::prepare_target_compilation(nobs_executable, DONT_USE_BUILD_DIR);
     internal::prepare_target_linking(nobs_executable, DONT_USE_BUILD_DIR);
+    nobs_executable.built = true;
     if (nobs_executable.needs_linking == false)
     {
         std::println("{}Nobs build script has not changed. No need to rebuild.{}", internal::GREEN_FONT, internal::RESET_FONT);
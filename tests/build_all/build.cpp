@@ -0,0 +1,27 @@
+#include "../../nobs.hpp"
+
+int main(const int argc, const char* argv[])
+{
+    using namespace nobs;
+    enable_command_line_params(argc, argv);
+    enable_self_rebuild();
+    set_build_directory("./build_dir");
+    auto& greeter = add_executable("greeter");
+    add_target_sources(greeter,
+        {
+            "greeter.cpp",
+            "shared.cpp",
+        });
+    add_target_compile_flag(greeter, "-std=c++23");
+
+    auto& counter = add_executable("counter");
+    add_target_sources(counter,
+        {
+            "counter.cpp",
+            "shared.cpp",
+        });
+    add_target_compile_flag(counter, "-std=c++23");
+    build_all();
+
+    return 0;
+}
@@ -0,0 +1,9 @@
+#include <print>
+
+int shared_value();
+
+int main()
+{
+    std::println("Counter got {}", 2 * shared_value());
+    return 0;
+}
@@ -0,0 +1,9 @@
+#include <print>
+
+int shared_value();
+
+int main()
+{
+    std::println("Greeter got {}", shared_value());
+    return 0;
+}
@@ -0,0 +1,6 @@
+#include "value.hpp"
+
+int shared_value()
+{
+    return VALUE;
+}
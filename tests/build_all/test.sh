@@ -0,0 +1,22 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state
+rm -rf ./build_dir
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Generating header"
+echo "#define VALUE 21" > value.hpp
+echo "Running build of all targets"
+./build | tee ./build.log
+echo "Checking that object shared by targets was compiled once"
+test "$(grep -c "Compiling .*shared.cpp" ./build.log)" -eq 1
+echo "Running built applications"
+./build_dir/greeter | grep "Greeter got 21"
+./build_dir/counter | grep "Counter got 42"
+echo "Changing header of shared source"
+echo "#define VALUE 20" > value.hpp
+./build | tee ./rebuild.log
+test "$(grep -c "Compiling .*shared.cpp" ./rebuild.log)" -eq 1
+grep "Linking .*greeter" ./rebuild.log
+grep "Linking .*counter" ./rebuild.log
+./build_dir/greeter | grep "Greeter got 20"
+./build_dir/counter | grep "Counter got 40"
@@ -0,0 +1,19 @@
+#include "../../nobs.hpp"
+
+int main(const int argc, const char* argv[])
+{
+    using namespace nobs;
+    enable_command_line_params(argc, argv);
+    enable_self_rebuild();
+    set_build_directory("./build_dir");
+    auto& app = add_executable("state_app");
+    add_target_sources(app,
+        {
+            "main.cpp",
+            "first.cpp",
+        });
+    add_target_compile_flag(app, "-std=c++23");
+    build_all();
+
+    return 0;
+}
@@ -0,0 +1,9 @@
+#include <print>
+
+int first();
+
+int main()
+{
+    std::println("State result is {}", first());
+    return 0;
+}
@@ -0,0 +1,38 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state
+rm -rf ./build_dir
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+state_file=./build_dir/.nobs_state
+echo "Running build"
+./build
+./build_dir/state_app | grep "State result is 42"
+echo "Running build with state read back"
+./build | tee ./build_dir/unchanged.log
+grep "Nothing to build" ./build_dir/unchanged.log
+echo "Appending torn record"
+state_size=$(stat -c %s $state_file)
+printf '\x40\x00\x00\x00\x00\x00\x00\x00torn' >> $state_file
+./build | tee ./build_dir/torn.log
+grep "Nothing to build" ./build_dir/torn.log
+test "$state_size" = "$(stat -c %s $state_file)"
+echo "Checking that record appended after recovery is read"
+touch first.cpp
+./build | tee ./build_dir/appended.log
+grep "Compiling .*first.cpp" ./build_dir/appended.log
+if grep "Compiling .*main.cpp" ./build_dir/appended.log; then exit 1; fi
+./build | tee ./build_dir/appended_unchanged.log
+grep "Nothing to build" ./build_dir/appended_unchanged.log
+echo "Cutting last record"
+truncate -s -3 $state_file
+./build | tee ./build_dir/cut.log
+grep "Compiling .*first.cpp" ./build_dir/cut.log
+if grep "Compiling .*main.cpp" ./build_dir/cut.log; then exit 1; fi
+echo "Replacing state with file of other format"
+echo "not a nobs state" > $state_file
+./build | tee ./build_dir/recreated.log
+grep "Compiling .*main.cpp" ./build_dir/recreated.log
+grep "Compiling .*first.cpp" ./build_dir/recreated.log
+./build | tee ./build_dir/recreated_unchanged.log
+grep "Nothing to build" ./build_dir/recreated_unchanged.log
+./build_dir/state_app | grep "State result is 42"
@@ -0,0 +1,21 @@
+#include "../../nobs.hpp"
+
+int main(const int argc, const char* argv[])
+{
+    using namespace nobs;
+    enable_command_line_params(argc, argv);
+    enable_self_rebuild();
+    const char* build_dir = std::getenv("BUILD_DIR");
+    set_build_directory(build_dir ? build_dir : "./build_dir");
+    enable_compilation_cache("./cache_dir");
+    auto& app = add_executable("cache_app");
+    add_target_sources(app, {"main.cpp"});
+    add_target_compile_flag(app, "-std=c++23");
+    if (const char* extra_flag = std::getenv("EXTRA_FLAG"))
+    {
+        add_target_compile_flag(app, extra_flag);
+    }
+    build_all();
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+#include <print>
+#include "value.hpp"
+
+#ifndef SUFFIX
+#define SUFFIX ""
+#endif
+
+int main()
+{
+    std::println("Value is {}{}", VALUE, SUFFIX);
+    return 0;
+}
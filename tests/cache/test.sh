@@ -0,0 +1,43 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state
+rm -rf ./build_dir ./other_build_dir ./cache_dir
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Generating header"
+echo "#define VALUE 1" > value.hpp
+echo "Running build filling the cache"
+./build | tee ./first.log
+grep "Compiling .*main.cpp" ./first.log
+./build_dir/cache_app | grep "Value is 1"
+echo "Running build after removing build directory"
+rm -rf ./build_dir ./.nobs_state
+./build | tee ./restored.log
+grep "Restored .*main.cpp" ./restored.log
+if grep "Compiling .*main.cpp" ./restored.log; then exit 1; fi
+./build_dir/cache_app | grep "Value is 1"
+echo "Changing header"
+echo "#define VALUE 2" > value.hpp
+rm -rf ./build_dir ./.nobs_state
+./build | tee ./header.log
+grep "Compiling .*main.cpp" ./header.log
+./build_dir/cache_app | grep "Value is 2"
+echo "Changing compile flags"
+rm -rf ./build_dir ./.nobs_state
+EXTRA_FLAG='-DSUFFIX="!"' ./build | tee ./flags.log
+grep "Compiling .*main.cpp" ./flags.log
+./build_dir/cache_app | grep "Value is 2!"
+echo "Restoring previous header"
+echo "#define VALUE 1" > value.hpp
+rm -rf ./build_dir ./.nobs_state
+./build | tee ./previous.log
+grep "Restored .*main.cpp" ./previous.log
+./build_dir/cache_app | grep "Value is 1"
+echo "Restoring into another build directory"
+BUILD_DIR=./other_build_dir ./build | tee ./other.log
+grep "Restored .*main.cpp" ./other.log
+./other_build_dir/cache_app | grep "Value is 1"
+echo "Changing header after restoring into another build directory"
+echo "#define VALUE 3" > value.hpp
+BUILD_DIR=./other_build_dir ./build | tee ./other_header.log
+grep "Compiling .*main.cpp" ./other_header.log
+./other_build_dir/cache_app | grep "Value is 3"
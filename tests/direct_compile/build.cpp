@@ -0,0 +1,16 @@
+#include "../../nobs.hpp"
+
+int main(const int argc, const char* argv[])
+{
+    using namespace nobs;
+    enable_command_line_params(argc, argv);
+    enable_self_rebuild();
+    set_build_directory("./build_dir");
+    set_compiler("./logging_clang++.sh");
+    auto& app = add_executable("direct_app");
+    add_target_sources(app, {"main.cpp"});
+    add_target_compile_flag(app, "-std=c++20");
+    build_all();
+
+    return 0;
+}
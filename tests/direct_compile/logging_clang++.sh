@@ -0,0 +1,4 @@
+#!/bin/bash
+# Logs every invocation of compiler driver, frontend started directly by nobs does not go through here
+echo "$@" >> ./driver.log
+exec clang++ "$@"
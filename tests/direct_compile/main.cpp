@@ -0,0 +1,8 @@
+#include <cstdio>
+#include "message.hpp"
+
+int main()
+{
+    std::printf("%s\n", MESSAGE);
+    return 0;
+}
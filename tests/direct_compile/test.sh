@@ -0,0 +1,28 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state ./driver.log
+rm -rf ./build_dir
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Generating header"
+echo '#define MESSAGE "Hello from direct compilation"' > message.hpp
+echo "Running build through compiler driver"
+./build
+grep -- "-c .*main.cpp" ./driver.log
+echo "Running build with direct compilation"
+rm -rf ./build_dir ./driver.log
+./build --direct-compile | tee ./direct.log
+echo "Checking that driver was only asked for frontend command"
+if grep "can't be skipped" ./direct.log; then exit 1; fi
+grep -- "-###" ./driver.log
+if grep -v -- "-###" ./driver.log | grep -- "-c "; then exit 1; fi
+echo "Checking that object and depfile were written to real paths"
+test -f ./build_dir/main.cpp.o
+grep "build_dir/main.cpp.o:" ./build_dir/main.cpp.o.d
+grep "message.hpp" ./build_dir/main.cpp.o.d
+if grep "nobs_direct_compile" ./build_dir/main.cpp.o.d; then exit 1; fi
+echo "Running built application"
+./build_dir/direct_app | grep "Hello from direct compilation"
+echo "Changing header"
+echo '#define MESSAGE "Hello again from direct compilation"' > message.hpp
+./build --direct-compile
+./build_dir/direct_app | grep "Hello again from direct compilation"
@@ -0,0 +1,9 @@
+#include <print>
+
+#include "version.hpp"
+
+int main()
+{
+    std::println("Version {}", VERSION);
+    return 0;
+}
@@ -0,0 +1,16 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Generating header"
+echo "#define VERSION 1" > version.hpp
+echo "Running build"
+./build
+echo "Running built application"
+./build_dir/header_app | grep "Version 1"
+echo "Changing header"
+echo "#define VERSION 2" > version.hpp
+echo "Running incremental build"
+./build
+echo "Running rebuilt application"
+./build_dir/header_app | grep "Version 2"
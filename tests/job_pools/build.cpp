@@ -0,0 +1,26 @@
+#include "../../nobs.hpp"
+
+int main(const int argc, const char* argv[])
+{
+    using namespace nobs;
+    enable_command_line_params(argc, argv);
+    enable_self_rebuild();
+    set_build_directory("./build_dir");
+    set_compiler("./counting_compiler.sh");
+    if (const char* depth = std::getenv("LINK_POOL_DEPTH"))
+    {
+        add_job_pool("app_links", std::stoull(depth));
+    }
+    for (const auto name : {"first", "second", "third", "fourth"})
+    {
+        auto& app = add_executable(std::format("{}_app", name));
+        add_target_sources(app, {std::format("{}.cpp", name)});
+        if (std::getenv("LINK_POOL_DEPTH"))
+        {
+            set_target_link_pool(app, "app_links");
+        }
+    }
+    build_all();
+
+    return 0;
+}
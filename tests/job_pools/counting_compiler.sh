@@ -0,0 +1,10 @@
+#!/bin/bash
+# Logs how many link jobs run at once, each of them takes a while so that links not limited by pool overlap
+if [[ " $* " != *" -c "* ]]; then
+    mkdir -p ./running_links
+    touch ./running_links/$$
+    ls ./running_links | wc -l >> ./link_concurrency.log
+    sleep 1
+    rm ./running_links/$$
+fi
+exec g++ "$@"
@@ -0,0 +1,7 @@
+#include <cstdio>
+
+int main()
+{
+    std::printf("Hello from first app\n");
+    return 0;
+}
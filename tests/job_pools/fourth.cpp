@@ -0,0 +1,7 @@
+#include <cstdio>
+
+int main()
+{
+    std::printf("Hello from fourth app\n");
+    return 0;
+}
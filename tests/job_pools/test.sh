@@ -0,0 +1,22 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state ./link_concurrency.log
+rm -rf ./build_dir ./running_links
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Running self rebuild, restarted build ignores command line arguments"
+./build > /dev/null 2>&1
+max_concurrency() { sort -n ./link_concurrency.log | tail -1; }
+echo "Running links without limit"
+rm -rf ./build_dir ./link_concurrency.log
+./build -m 4
+test "$(max_concurrency)" -ge 2
+echo "Running links limited by --link-jobs"
+rm -rf ./build_dir ./link_concurrency.log
+./build -m 4 --link-jobs 1
+test "$(max_concurrency)" -eq 1
+echo "Running links in pool of targets"
+rm -rf ./build_dir ./link_concurrency.log
+LINK_POOL_DEPTH=2 ./build -m 4
+test "$(max_concurrency)" -le 2
+test "$(wc -l < ./link_concurrency.log)" -eq 4
+./build_dir/fourth_app | grep "Hello from fourth app"
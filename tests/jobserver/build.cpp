@@ -0,0 +1,15 @@
+#include "../../nobs.hpp"
+
+int main(const int argc, const char* argv[])
+{
+    using namespace nobs;
+    enable_command_line_params(argc, argv);
+    enable_self_rebuild();
+    set_build_directory("./build_dir");
+    set_compiler("./counting_compiler.sh");
+    auto& app = add_executable("jobserver_app");
+    add_target_sources(app, {"main.cpp", "first.cpp", "second.cpp", "third.cpp", "fourth.cpp", "fifth.cpp"});
+    build_all();
+
+    return 0;
+}
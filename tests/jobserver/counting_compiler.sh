@@ -0,0 +1,8 @@
+#!/bin/bash
+# Logs how many compile and link jobs run at once, each of them takes a while so that jobs not limited overlap
+mkdir -p ./running_jobs
+touch ./running_jobs/$$
+ls ./running_jobs | wc -l >> ./job_concurrency.log
+sleep 1
+rm ./running_jobs/$$
+exec g++ "$@"
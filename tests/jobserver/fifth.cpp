@@ -0,0 +1,4 @@
+int fifth()
+{
+    return 5;
+}
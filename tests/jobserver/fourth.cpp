@@ -0,0 +1,4 @@
+int fourth()
+{
+    return 4;
+}
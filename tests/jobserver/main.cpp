@@ -0,0 +1,13 @@
+#include <cstdio>
+
+int first();
+int second();
+int third();
+int fourth();
+int fifth();
+
+int main()
+{
+    std::printf("Sum is %d\n", first() + second() + third() + fourth() + fifth());
+    return 0;
+}
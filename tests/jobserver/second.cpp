@@ -0,0 +1,4 @@
+int second()
+{
+    return 2;
+}
@@ -0,0 +1,23 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state ./job_concurrency.log
+rm -rf ./build_dir ./running_jobs
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Running self rebuild, restarted build ignores command line arguments"
+./build > /dev/null 2>&1
+max_concurrency() { sort -n ./job_concurrency.log | tail -1; }
+echo "Running jobs without jobserver"
+rm -rf ./build_dir ./job_concurrency.log
+./build -m 8
+test "$(max_concurrency)" -gt 2
+echo "Running jobs as client of make jobserver"
+rm -rf ./build_dir ./job_concurrency.log
+make -j2
+test "$(max_concurrency)" -le 2
+./build_dir/jobserver_app | grep "Sum is 15"
+echo "Running jobs as client of make jobserver with --jobserver"
+rm -rf ./build_dir ./job_concurrency.log
+make -j2 NOBS_FLAGS=--jobserver
+test "$(max_concurrency)" -le 2
+test "$(wc -l < ./job_concurrency.log)" -eq 7
+./build_dir/jobserver_app | grep "Sum is 15"
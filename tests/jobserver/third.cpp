@@ -0,0 +1,4 @@
+int third()
+{
+    return 3;
+}
@@ -0,0 +1 @@
+int first() { return missing_first; }
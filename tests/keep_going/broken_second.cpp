@@ -0,0 +1 @@
+int second() { return missing_second; }
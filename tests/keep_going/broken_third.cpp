@@ -0,0 +1 @@
+int third() { return missing_third; }
@@ -0,0 +1,21 @@
+#include "../../nobs.hpp"
+
+int main(const int argc, const char* argv[])
+{
+    using namespace nobs;
+    enable_command_line_params(argc, argv);
+    set_build_directory("./build_dir");
+
+    auto& app = add_executable("keep_going_app");
+    add_target_sources(app,
+        {
+            "broken_first.cpp",
+            "broken_second.cpp",
+            "broken_third.cpp",
+            "main.cpp",
+        });
+    add_target_compile_flag(app, "-std=c++23");
+    build_target(app);
+
+    return 0;
+}
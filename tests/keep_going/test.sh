@@ -0,0 +1,18 @@
+set -e
+echo "Building nobs"
+rm -rf ./build ./.nobs_state ./build_dir
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Running build stopping at first failure"
+./build -m 1 > ./stop.log && exit 1
+cat ./stop.log
+grep "1 jobs failed, 1 skipped, 2 not started" ./stop.log
+echo "Running build keeping going"
+./build -m 1 -k 0 > ./keep_going.log && exit 1
+cat ./keep_going.log
+grep "3 jobs failed, 1 skipped, 0 not started" ./keep_going.log
+test -f ./build_dir/main.cpp.o
+echo "Running build stopping after two failures"
+rm -rf ./build_dir ./.nobs_state
+./build -m 1 -k 2 > ./two_failures.log && exit 1
+cat ./two_failures.log
+grep "2 jobs failed, 1 skipped, 1 not started" ./two_failures.log
@@ -0,0 +1,20 @@
+#include "../../nobs.hpp"
+
+int main(const int argc, const char* argv[])
+{
+    using namespace nobs;
+    enable_command_line_params(argc, argv);
+    enable_self_rebuild();
+    set_build_directory("./build_dir");
+    set_compiler("./missing_compiler");
+    enable_keep_going();
+    auto& app = add_executable("missing_app");
+    add_target_sources(app,
+        {
+            "main.cpp",
+            "first.cpp",
+        });
+    build_all();
+
+    return 0;
+}
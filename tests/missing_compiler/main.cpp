@@ -0,0 +1,6 @@
+int first();
+
+int main()
+{
+    return first();
+}
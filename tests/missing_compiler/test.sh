@@ -0,0 +1,14 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state
+rm -rf ./build_dir
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Running build with missing compiler"
+./build > ./build.log 2>&1 && exit 1
+cat ./build.log
+echo "Checking that every compile job failed and nobs kept going"
+grep "Failed to execute ./missing_compiler" ./build.log
+grep "Build of .* failed: 2 jobs failed, 1 skipped, 0 not started" ./build.log
+grep "\[code 127\] ./missing_compiler .*main.cpp" ./build.log
+grep "\[code 127\] ./missing_compiler .*first.cpp" ./build.log
+if grep "Linking" ./build.log; then exit 1; fi
@@ -0,0 +1,14 @@
+module;
+#include "value.hpp"
+export module greeting;
+import numbers;
+
+export const char* greeting()
+{
+    return "Hello from module";
+}
+
+export int value()
+{
+    return twice(VALUE);
+}
@@ -0,0 +1,8 @@
+#include <cstdio>
+import greeting;
+
+int main()
+{
+    std::printf("%s, value is %d\n", greeting(), value());
+    return 0;
+}
@@ -0,0 +1,6 @@
+export module numbers;
+
+export int twice(int value)
+{
+    return 2 * value;
+}
@@ -0,0 +1,24 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state
+rm -rf ./build_dir
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Generating header"
+echo "#define VALUE 1" > value.hpp
+echo "Running first build, importers are listed before module interfaces"
+./build
+echo "Running built application"
+./build_dir/module_app | grep "Hello from module, value is 2"
+echo "Changing header included by module interface"
+echo "#define VALUE 2" > value.hpp
+echo "Running incremental build"
+./build | tee ./build_dir/incremental.log
+echo "Checking that importer was rebuilt with module interface"
+grep "greeting.cppm" ./build_dir/incremental.log
+grep "main.cpp" ./build_dir/incremental.log
+if grep "numbers.cppm" ./build_dir/incremental.log; then exit 1; fi
+echo "Running rebuilt application"
+./build_dir/module_app | grep "Hello from module, value is 4"
+echo "Running build without changes"
+./build | tee ./build_dir/unchanged.log
+grep "Nothing to build" ./build_dir/unchanged.log
@@ -6,3 +6,5 @@ echo "Running build"
 echo "Running built application"
 ./build_dir/one_file_app
 
+echo "Checking that self rebuild left no captured output behind"
+if ls ./*.diag 2>/dev/null; then exit 1; fi
@@ -0,0 +1,23 @@
+#include "../../nobs.hpp"
+
+int main(const int argc, const char* argv[])
+{
+    using namespace nobs;
+    enable_command_line_params(argc, argv);
+    enable_self_rebuild();
+    set_build_directory("./build_dir");
+    auto& app = add_executable("pch_app");
+    add_target_sources(app,
+        {
+            "main.cpp",
+            "words.cpp",
+        });
+
+    add_target_precompiled_header(app, "common.hpp");
+    add_target_compile_flag(app, "-std=c++23");
+    add_target_compile_flag(app, "-Winvalid-pch");
+    add_target_compile_flag(app, "-Werror=invalid-pch");
+    build_target(app);
+
+    return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <print>
+#include <string>
+#include <vector>
+
+std::vector<std::string> words();
@@ -0,0 +1,8 @@
+int main()
+{
+    for (const auto& word : words())
+    {
+        std::println("{}", word);
+    }
+    return 0;
+}
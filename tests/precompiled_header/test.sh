@@ -0,0 +1,14 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Running build"
+./build
+echo "Checking precompiled header"
+test -f ./build_dir/pch/pch_app/common.hpp.gch
+echo "Running built application"
+./build_dir/pch_app
+echo "Checking that precompiled header is used"
+touch main.cpp
+./build --include-report > ./build_dir/include_report.log 2>&1
+grep "! .*common.hpp.gch" ./build_dir/include_report.log
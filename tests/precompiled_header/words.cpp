@@ -0,0 +1,4 @@
+std::vector<std::string> words()
+{
+    return {"Precompiled", "header", "works!"};
+}
@@ -0,0 +1,20 @@
+#include "../../nobs.hpp"
+
+int main(const int argc, const char* argv[])
+{
+    using namespace nobs;
+    enable_command_line_params(argc, argv);
+    enable_self_rebuild();
+    set_build_directory("./build_dir");
+    set_response_file_threshold(1);
+    auto& app = add_executable("response_app");
+    add_target_sources(app,
+        {
+            "main.cpp",
+            "first.cpp",
+        });
+    add_target_compile_flag(app, "-std=c++23");
+    build_all();
+
+    return 0;
+}
@@ -0,0 +1,9 @@
+#include <print>
+
+int first();
+
+int main()
+{
+    std::println("Response file result is {}", first());
+    return 0;
+}
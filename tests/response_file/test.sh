@@ -0,0 +1,23 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state
+rm -rf ./build_dir
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Running build with every command in response file"
+./build
+echo "Checking response files"
+grep -- "-c" ./build_dir/main.cpp.o.rsp
+grep "first.cpp.o" ./build_dir/response_app.rsp
+echo "Running built application"
+./build_dir/response_app | grep "Response file result is 42"
+echo "Running rebuild with unchanged command lines"
+compile_stamp=$(stat -c %y ./build_dir/main.cpp.o.rsp)
+link_stamp=$(stat -c %y ./build_dir/response_app.rsp)
+sleep 1
+touch main.cpp
+./build | tee ./build_dir/rebuild.log
+grep "Compiling .*main.cpp" ./build_dir/rebuild.log
+echo "Checking that response files were not rewritten"
+test "$compile_stamp" = "$(stat -c %y ./build_dir/main.cpp.o.rsp)"
+test "$link_stamp" = "$(stat -c %y ./build_dir/response_app.rsp)"
+./build_dir/response_app | grep "Response file result is 42"
@@ -1,6 +1,6 @@
 set -e
 echo "Building nobs"
-rm -f ./build ./build.cpp.o.meta
+rm -f ./build ./.nobs_state
 g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp 
 echo "Running build"
 ./build
@@ -0,0 +1,6 @@
+#include "value.hpp"
+
+int add(const int a, const int b)
+{
+    return a + b + OFFSET;
+}
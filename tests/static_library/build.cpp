@@ -0,0 +1,30 @@
+#include "../../nobs.hpp"
+
+int main(const int argc, const char* argv[])
+{
+    using namespace nobs;
+    enable_command_line_params(argc, argv);
+    enable_self_rebuild();
+    set_build_directory("./build_dir");
+    auto& math = add_static_library("math");
+    add_target_sources(math,
+        {
+            "add.cpp",
+            "multiply.cpp",
+        });
+    add_target_compile_flag(math, "-std=c++23");
+
+    auto& text = add_static_library("text");
+    add_target_sources(text, {"text/greet.cpp"});
+    add_target_compile_flag(text, "-std=c++23");
+    set_target_thin_archive(text);
+
+    auto& app = add_executable("library_app");
+    add_target_sources(app, {"main.cpp"});
+    add_target_compile_flag(app, "-std=c++23");
+    add_target_link_library(app, math);
+    add_target_link_library(app, text);
+    build_all();
+
+    return 0;
+}
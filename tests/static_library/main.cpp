@@ -0,0 +1,12 @@
+#include <print>
+#include <string>
+
+int add(const int a, const int b);
+int multiply(const int a, const int b);
+std::string greet();
+
+int main()
+{
+    std::println("{}, result is {}", greet(), add(multiply(4, 10), 2));
+    return 0;
+}
@@ -0,0 +1,4 @@
+int multiply(const int a, const int b)
+{
+    return a * b;
+}
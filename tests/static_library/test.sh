@@ -0,0 +1,22 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Generating header"
+echo "#define OFFSET 0" > value.hpp
+echo "Running build"
+./build
+echo "Checking archives"
+ar t ./build_dir/libmath.a | grep "multiply.cpp.o"
+ar t ./build_dir/libtext.a | grep "greet.cpp.o"
+echo "Running built application"
+./build_dir/library_app | grep "Hello from library, result is 42"
+echo "Changing header"
+echo "#define OFFSET 1" > value.hpp
+echo "Running incremental build"
+./build | tee ./build_dir/incremental.log
+echo "Checking that only changed member was replaced"
+grep "Archiving ar rcs .*add.cpp.o" ./build_dir/incremental.log
+if grep "Archiving ar .*multiply.cpp.o" ./build_dir/incremental.log; then exit 1; fi
+echo "Running rebuilt application"
+./build_dir/library_app | grep "Hello from library, result is 43"
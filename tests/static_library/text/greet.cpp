@@ -0,0 +1,6 @@
+#include <string>
+
+std::string greet()
+{
+    return "Hello from library";
+}
@@ -0,0 +1,4 @@
+int first()
+{
+    return 40;
+}
@@ -0,0 +1,10 @@
+#include <print>
+
+int first();
+int second();
+
+int main()
+{
+    std::println("Unity result is {}", first() + second());
+    return 0;
+}
@@ -0,0 +1,14 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Running unity build"
+./build
+echo "Checking unity sources"
+test -f ./build_dir/unity/unity_app/unity_app_unity_0.cpp
+echo "Running built application"
+./build_dir/unity_app | grep "Unity result is 42"
+echo "Running build without unity"
+./build --no-unity
+echo "Running built application"
+./build_dir/unity_app | grep "Unity result is 42"
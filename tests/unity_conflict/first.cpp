@@ -0,0 +1,12 @@
+namespace
+{
+int helper()
+{
+    return 40;
+}
+}
+
+int first()
+{
+    return helper();
+}
@@ -0,0 +1,12 @@
+namespace
+{
+int helper()
+{
+    return 2;
+}
+}
+
+int second()
+{
+    return helper();
+}
@@ -0,0 +1,32 @@
+set -e
+echo "Building nobs"
+rm -f ./build ./.nobs_state
+rm -rf ./build_dir
+g++ -g -std=gnu++23 -I ../../ -o ./build build.cpp
+echo "Running self rebuild, restarted build ignores command line arguments"
+./build > /dev/null 2>&1 || true
+rm -rf ./build_dir
+state_file=./build_dir/unity/conflict_app/unity.state
+echo "Running unity build with conflicting sources in one batch"
+./build -m 1 > ./batch.log && exit 1
+grep "suspect .*first.cpp" $state_file
+grep "suspect .*second.cpp" $state_file
+echo "Running build compiling suspects separately"
+./build -m 1 | tee ./suspects.log
+grep "Compiling .*first.cpp" ./suspects.log
+grep "Source .*first.cpp does not compile in unity batch" ./suspects.log
+grep "excluded .*first.cpp" $state_file
+grep "excluded .*second.cpp" $state_file
+if grep "suspect" $state_file; then exit 1; fi
+./build_dir/conflict_app | grep "Conflict result is 42"
+echo "Running build without unity first"
+rm -rf ./build_dir
+./build --no-unity
+./build -m 1 > ./batch.log && exit 1
+echo "Running build with up to date objects of suspects"
+./build -m 1 | tee ./up_to_date.log
+if grep "Compiling .*first.cpp" ./up_to_date.log; then exit 1; fi
+grep "Source .*first.cpp does not compile in unity batch" ./up_to_date.log
+grep "excluded .*second.cpp" $state_file
+if grep "suspect" $state_file; then exit 1; fi
+./build_dir/conflict_app | grep "Conflict result is 42"